@@ -100,7 +100,7 @@ func update_shown_pose_data(value: float) -> void:
 
 	rd.clear()
 	var animlib :AnimationLibrary= _current as AnimationLibrary
-	var anim_name := animlib.get_animation_list()[_current.db_anim_index[pose_index]]
+	var anim_name := _current.get_row_animation_name(pose_index)
 	var anim := animlib.get_animation(anim_name)
 	var anim_timestep := _current.db_anim_timestamp[pose_index]
 	var anim_cat := _current.db_anim_category[pose_index]
@@ -207,7 +207,7 @@ func _on_choose_animation_pressed(ID) -> void:
 		if _current.db_anim_index.size() != 0:
 			var i :int= 0
 			for index in _current.db_anim_index:
-				if index == ID:
+				if _current.get_row_animation_name(i) == StringName(_current.get_animation_list()[ID]):
 					$TabContainer/Data/HBoxContainer/MarginContainer2/HBoxContainer/SpinBox.value = i
 					update_shown_pose_data(i)
 					break
@@ -295,7 +295,7 @@ func set_skeleton_to_pose(index:float):
 		pose[i] = pose[i] * _current.variances[i] + _current.means[i]
 
 	var animlib :AnimationLibrary= _current as AnimationLibrary
-	var anim_name := animlib.get_animation_list()[_current.db_anim_index[pose_index]]
+	var anim_name := _current.get_row_animation_name(pose_index)
 	var anim := animlib.get_animation(anim_name)
 	var anim_timestep := _current.db_anim_timestamp[pose_index]
 
@@ -21,6 +21,22 @@
 
 using namespace godot;
 
+// Track indices of a bone inside one animation. -1 when the animation doesn't have the track.
+// Resolve them once per animation, find_track is a string lookup.
+struct kform_tracks
+{
+    int32_t pos = -1;
+    int32_t rot = -1;
+    int32_t scl = -1;
+
+    kform_tracks() = default;
+    kform_tracks(const Ref<Animation>& anim,const NodePath& bonepath) :
+        pos{anim->find_track(bonepath,Animation::TrackType::TYPE_POSITION_3D)},
+        rot{anim->find_track(bonepath,Animation::TrackType::TYPE_ROTATION_3D)},
+        scl{anim->find_track(bonepath,Animation::TrackType::TYPE_SCALE_3D)}
+    {}
+};
+
 struct kform
 {
     Quaternion rot = Quaternion();
@@ -45,26 +61,29 @@ struct kform
     {}
 
     kform(Ref<SkeletonProfile> skel,NodePath bonepath,Ref<Animation> anim,double time) : 
-        kform{skel->get_reference_pose(skel->find_bone(bonepath.get_concatenated_subnames()))}
+        kform{kform{skel->get_reference_pose(skel->find_bone(bonepath.get_concatenated_subnames()))}, anim, kform_tracks{anim,bonepath}, time}
+    {}
+
+    // Sample a bone whose tracks were already resolved. No string lookup is done here,
+    // the reference pose is used for the missing tracks.
+    kform(const kform& reference,const Ref<Animation>& anim,const kform_tracks& tracks,double time) : 
+        kform{reference}
     {
-        auto tpos = anim->find_track(bonepath,Animation::TrackType::TYPE_POSITION_3D);
-        auto trot = anim->find_track(bonepath,Animation::TrackType::TYPE_ROTATION_3D);
-        auto tscl = anim->find_track(bonepath,Animation::TrackType::TYPE_SCALE_3D);
         kform s1 = *this;
-        if (tpos != -1)
+        if (tracks.pos != -1)
         {
-            pos = anim->position_track_interpolate(tpos, time);
-            s1.pos = anim->position_track_interpolate(tpos, time + dt);
+            pos = anim->position_track_interpolate(tracks.pos, time);
+            s1.pos = anim->position_track_interpolate(tracks.pos, time + dt);
         }
-        if (trot != -1)
+        if (tracks.rot != -1)
         {
-            rot = anim->rotation_track_interpolate(trot, time);
-            s1.rot = anim->rotation_track_interpolate(trot, time + dt);
+            rot = anim->rotation_track_interpolate(tracks.rot, time);
+            s1.rot = anim->rotation_track_interpolate(tracks.rot, time + dt);
         }
-        if (tscl != -1)
+        if (tracks.scl != -1)
         {
-            scl = anim->scale_track_interpolate(tscl, time);
-            s1.scl = anim->scale_track_interpolate(tscl, time + dt);
+            scl = anim->scale_track_interpolate(tracks.scl, time);
+            s1.scl = anim->scale_track_interpolate(tracks.scl, time + dt);
         }
         *this = finite_difference(*this,s1,dt);
     }
@@ -97,27 +116,7 @@ struct kform
     static constexpr double dt = 0.016;
     //DONE
     void _local(Ref<SkeletonProfile> skel,Ref<Animation> anim,double time,NodePath bonepath){
-        *this = skel->get_reference_pose(skel->find_bone(bonepath.get_concatenated_subnames()));
-        auto tpos = anim->find_track(bonepath,Animation::TrackType::TYPE_POSITION_3D);
-        auto trot = anim->find_track(bonepath,Animation::TrackType::TYPE_ROTATION_3D);
-        auto tscl = anim->find_track(bonepath,Animation::TrackType::TYPE_SCALE_3D);
-        kform s1 = *this;
-        if (tpos != -1)
-        {
-            pos = anim->position_track_interpolate(tpos, time);
-            s1.pos = anim->position_track_interpolate(tpos, time + dt);
-        }
-        if (trot != -1)
-        {
-            rot = anim->rotation_track_interpolate(trot, time);
-            s1.rot = anim->rotation_track_interpolate(trot, time + dt);
-        }
-        if (tscl != -1)
-        {
-            scl = anim->scale_track_interpolate(tscl, time);
-            s1.scl = anim->scale_track_interpolate(tscl, time + dt);
-        }
-        *this = finite_difference(*this,s1,dt);
+        *this = kform{skel,bonepath,anim,time};
     }
     // Done
     void _model(Ref<SkeletonProfile> skel,Ref<Animation> anim,double time,NodePath bonepath){
@@ -241,6 +240,10 @@ struct kforms
         pos.reserve(N); rot.reserve(N); scl.reserve(N);vel.reserve(N); ang.reserve(N); svl.reserve(N);
     }
 
+    void resize(std::size_t N){
+        pos.resize(N,Vector3()); rot.resize(N,Quaternion()); scl.resize(N,Vector3(1,1,1));vel.resize(N,Vector3()); ang.resize(N,Vector3()); svl.resize(N,Vector3());
+    }
+
     std::size_t count() const noexcept {
         return pos.size();
     }
@@ -256,6 +259,15 @@ struct kforms
         return out;
     }
 
+    inline void set(const std::size_t N,const kform& value) noexcept{
+        pos[N] = value.pos;
+        rot[N] = value.rot;
+        scl[N] = value.scl;
+        vel[N] = value.vel;
+        ang[N] = value.ang;
+        svl[N] = value.svl;
+    }
+
     void reset(const std::size_t N){
         pos[N] = Vector3() ;rot[N] = Quaternion(); scl[N] = Vector3(1,1,1) ;vel[N] = Vector3();ang[N] = Vector3();svl[N] = Vector3();
     }
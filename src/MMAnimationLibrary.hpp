@@ -18,6 +18,9 @@
 #include <godot_cpp/classes/animation_library.hpp>
 #include <godot_cpp/classes/animation_player.hpp>
 #include <godot_cpp/classes/bone_map.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/classes/ref_counted.hpp>
 
 #include <godot_cpp/classes/character_body3d.hpp>
 #include <godot_cpp/classes/skeleton3d.hpp>
@@ -28,11 +31,17 @@
 #include <chrono>
 #include <algorithm>
 #include <numeric>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cmath>
 
 #include "godot_cpp/core/math.hpp"
 
 #include "kdtree-cpp/kdtree.hpp"
+#include "MMDatabaseIndex.hpp"
 #include "MotionFeatures/MotionFeatures.hpp"
+#include "SkeletonSampler.hpp"
 
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
@@ -51,7 +60,53 @@ using namespace godot;
         ClassDB::bind_method( D_METHOD(STRING_PREFIX(get_,variable) ), &type::get_##variable); \
         ADD_PROPERTY(PropertyInfo(variant_type,#variable,__VA_ARGS__),STRING_PREFIX(set_,variable),STRING_PREFIX(get_,variable));
 
-// TODO : Save the array in a hashed data structure, so that multiple object doesn't add a new array for each schema.
+// Result of MMAnimationLibrary::query_pose_packed. Meant to be kept and reused from one query to the next,
+// so querying every frame doesn't allocate a Dictionary.
+struct MMQueryResult : public RefCounted
+{
+    GDCLASS(MMQueryResult,RefCounted)
+
+    int64_t animation_index = -1; // db_anim_index of the row
+    StringName animation{};
+    Ref<Animation> animation_resource{};
+    float timestamp = 0.0f;
+    int64_t row = -1;
+    float cost = 0.0f;
+    bool mirrored = false;
+    float rate = 1.0f;
+
+    int64_t get_animation_index(){return animation_index;}
+    StringName get_animation(){return animation;}
+    Ref<Animation> get_animation_resource(){return animation_resource;}
+    float get_timestamp(){return timestamp;}
+    int64_t get_row(){return row;}
+    float get_cost(){return cost;}
+    bool get_mirrored(){return mirrored;}
+    float get_rate(){return rate;}
+
+protected:
+    static void _bind_methods()
+    {
+        ClassDB::bind_method(D_METHOD("get_animation_index"), &MMQueryResult::get_animation_index);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "animation_index"), "", "get_animation_index");
+        ClassDB::bind_method(D_METHOD("get_animation"), &MMQueryResult::get_animation);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::STRING_NAME, "animation"), "", "get_animation");
+        ClassDB::bind_method(D_METHOD("get_animation_resource"), &MMQueryResult::get_animation_resource);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::OBJECT, "animation_resource", PROPERTY_HINT_RESOURCE_TYPE, "Animation"), "", "get_animation_resource");
+        ClassDB::bind_method(D_METHOD("get_timestamp"), &MMQueryResult::get_timestamp);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT, "timestamp"), "", "get_timestamp");
+        ClassDB::bind_method(D_METHOD("get_row"), &MMQueryResult::get_row);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "row"), "", "get_row");
+        ClassDB::bind_method(D_METHOD("get_cost"), &MMQueryResult::get_cost);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT, "cost"), "", "get_cost");
+        ClassDB::bind_method(D_METHOD("get_mirrored"), &MMQueryResult::get_mirrored);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL, "mirrored"), "", "get_mirrored");
+        ClassDB::bind_method(D_METHOD("get_rate"), &MMQueryResult::get_rate);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT, "rate"), "", "get_rate");
+    }
+};
+
+// The search index is shared between the libraries with the same baked content, see MMDatabaseRegistry.
 struct MMAnimationLibrary : public AnimationLibrary {
     using u = godot::UtilityFunctions;
     GDCLASS(MMAnimationLibrary,AnimationLibrary)
@@ -59,36 +114,26 @@ struct MMAnimationLibrary : public AnimationLibrary {
     MMAnimationLibrary() : AnimationLibrary()
     {
         u::prints("MMAL", "Constructor",MotionData.size());
+        connect("animation_added", Callable(this, "_invalidate_animation_table").unbind(1));
+        connect("animation_removed", Callable(this, "_invalidate_animation_table").unbind(1));
+        connect("animation_renamed", Callable(this, "_invalidate_animation_table").unbind(2));
     }
     ~MMAnimationLibrary()
     {
         u::prints("MMAL", "Destructor");
-        if (kdt != nullptr)
-        {
-            delete kdt;
-        }
+        _wait_index_task();
+        _clear_lods();
     }
 
     void _notification(int what)
     {
         switch (what)
         {
-        case NOTIFICATION_POSTINITIALIZE: // Constructor
-        {
-            u::prints("MMAL NOTIFICATION_POSTINITIALIZE", "InEditor:", godot::Engine::get_singleton()->is_editor_hint());
-            if (!Engine::get_singleton()->is_editor_hint())
-            {
-                fill_kdtree();
-            }
-        }
-        break;
         case NOTIFICATION_PREDELETE: // Destructor
         {
             u::prints("MMAL NOTIFICATION_PREDELETE", "InEditor:", godot::Engine::get_singleton()->is_editor_hint());
-            if (kdt != nullptr)
-            {
-                delete kdt;
-            }
+            _wait_index_task();
+            _clear_lods();
         }
         break;
         default:
@@ -100,28 +145,71 @@ struct MMAnimationLibrary : public AnimationLibrary {
     GETSET(Ref<SkeletonProfile>,skeleton_profile)
     GETSET(float,time_interval);
 
+    // Adaptive sampling : candidates are baked every adaptive_interval, and a row is only kept when its distance
+    // to the last kept row is over adaptive_threshold, when its category changes, or after adaptive_max_gap seconds.
+    GETSET(bool,adaptive_sampling,false);
+    GETSET(float,adaptive_interval,1.0f/30.0f);
+    GETSET(float,adaptive_threshold,0.5f);
+    GETSET(float,adaptive_max_gap,0.5f);
+
+    // Continuations : bake_data searches, for the last row of each clip that doesn't loop, the continuation_count
+    // best rows of the other clips matching the continuation categories. MMAnimationPlayer plays the first one
+    // as soon as the clip ends, without waiting for a search. Recomputed by each bake_data.
+    GETSET(bool,bake_continuations,false);
+    GETSET(int,continuation_count,3);
+    GETSET(int64_t,continuation_included_category,std::numeric_limits<int64_t>::max());
+    GETSET(int64_t,continuation_excluded_category,0);
+    // Animation name -> Array of {animation, timestamp, cost}, best first.
+    GETSET(Dictionary,continuations);
+
     // Category tracks
     GETSET(TypedArray<String>,category_track_names)
+    // Cost bias of the poses : a value track sampled at each row, plus a bias per animation name.
+    // Added to the distance of the pose in every search, a positive bias makes a pose less likely to be chosen.
+    GETSET(String,bias_track_name)
+    Dictionary animation_biases{};
+    Dictionary get_animation_biases(){return animation_biases;}
+    void set_animation_biases(Dictionary value){animation_biases = value; _rebuild_index_in_background();}
     // Array of the motion features.
-    GETSET(TypedArray<MotionFeature>, motion_features);
+    TypedArray<MotionFeature> motion_features{};
+    TypedArray<MotionFeature> get_motion_features(){return motion_features;}
+    void set_motion_features(TypedArray<MotionFeature> value)
+    {
+        motion_features = value;
+        // Built from the features, see _setup_mirror and _setup_rate_exponents.and _setup_rate_exponents.
+        mirror_permutation.clear();
+        mirror_signs.clear();
+        rate_exponents.clear();
+    }
     // The data
-    GETSET(PackedFloat32Array,MotionData);
+    PackedFloat32Array MotionData{};
+    PackedFloat32Array get_MotionData(){return MotionData;}
+    void set_MotionData(PackedFloat32Array value){MotionData = value; invalidate_index();}
 
     // Dimensional Stats.
     GETSET(int,nb_dimensions)
-    GETSET(PackedFloat32Array,weights)
+    PackedFloat32Array weights{};
+    PackedFloat32Array get_weights(){return weights;}
+    void set_weights(PackedFloat32Array value){weights = value; _rebuild_index_in_background();}
     GETSET(PackedFloat32Array,means)
     GETSET(PackedFloat32Array,variances)
     GETSET(Array,densities) 
 
     // Database. A pose is just the index of a row in the kdtree.
     // Usage : db_anim_*[result.index] = 
-    GETSET(PackedInt32Array,    db_anim_index);     // Index of the animation name in the animation library
+    PackedInt32Array db_anim_index{};                  // Index of the animation name in the animation library
+    PackedInt32Array get_db_anim_index(){return db_anim_index;}
+    void set_db_anim_index(PackedInt32Array value){db_anim_index = value; animation_row_ranges.clear(); _clear_lods();}
     GETSET(PackedFloat32Array,  db_anim_timestamp); // timestamp of the pose in the animation
-    GETSET(PackedInt32Array,    db_anim_category);  // Category of the pose in the animation
+    PackedInt32Array db_anim_category{};               // Category of the pose in the animation
+    PackedInt32Array get_db_anim_category(){return db_anim_category;}
+    void set_db_anim_category(PackedInt32Array value){db_anim_category = value; invalidate_index();}
+    PackedFloat32Array db_anim_bias{};                 // Bias of the pose, from bias_track_name
+    PackedFloat32Array get_db_anim_bias(){return db_anim_bias;}
+    void set_db_anim_bias(PackedFloat32Array value){db_anim_bias = value; _rebuild_index_in_background();}
 
-    // The KdTree.
-    Kdtree::KdTree *  kdt = nullptr;
+    // Whole skeleton poses shared by all the features while baking.
+    SkeletonSampler skeleton_sampler{};
 
 
     // How the kdtree calculate the distance.
@@ -131,269 +219,1454 @@ struct MMAnimationLibrary : public AnimationLibrary {
     int distance_type = 1; int get_distance_type(){return distance_type;} 
     void set_distance_type(int value){
         distance_type = value;
-        if(kdt != nullptr && 0 <= distance_type && distance_type <= 2)
-            kdt->set_distance(distance_type);
+        _rebuild_index_in_background();
     }
 
-    void _cache_kdtree(bool reset = false){
-        if(reset)
+    // The search index is built on the first query, not when the library is loaded,
+    // or taken from MMDatabaseRegistry when another library already built it for the same content.
+    // With async_index_build, it is built on a worker thread and the queries use a brute force search until
+    // it's ready. index_ready is emitted once it can be used.
+    // When only the weights or the distance change, the previous index keeps serving the queries while the new one
+    // is built, then it is swapped atomically. A query holding the previous index keeps it alive until it's done.
+    GETSET(bool,async_index_build,true);
+    std::shared_ptr<MMDatabaseIndex> index{}; // Only accessed through std::atomic_load/std::atomic_store.
+    std::shared_ptr<MMDatabaseIndex> built_index{}; // Set by the worker, guarded by index_mutex.
+    std::mutex index_mutex{};
+    int64_t index_task_id = -1;
+    uint64_t index_generation = 0; // Incremented when anything used by the index changes.
+    uint64_t published_generation = 0; // Generation of the current index.
+    uint64_t building_generation = 0; // Generation of the index task.
+
+    // Input of the index task, copied when the task starts so the library data can change meanwhile.
+    PackedFloat32Array index_task_data{};
+    PackedInt32Array index_task_categories{};
+    PackedFloat32Array index_task_weights{};
+    PackedInt32Array index_task_anim_index{};
+    PackedFloat32Array index_task_row_biases{};
+    std::vector<float> index_task_animation_biases{};
+    int32_t index_task_dimensions = 0;
+    int index_task_distance_type = 1;
+    GETSET(int,max_index_segments,8);
+
+    // After a query, search the time between the best row and its neighbors in the same animation
+    // minimizing the distance, with the features interpolated linearly between the rows.
+    // Lets the database be baked with a coarser time_interval without quantized timestamps.
+    GETSET(bool,refine_timestamp,false);
+    GETSET(int,refine_iterations,10);
+
+    // Also search the mirrored poses, left and right swapped, without baking mirrored animations :
+    // the query is mirrored and searched in the same index. When a mirrored pose wins, query_pose returns
+    // mirrored = true and the animation must be played mirrored, see MMAnimationPlayer::request_animation.
+    // The weights of the two sides must be the same.
+    GETSET(bool,mirror_search,false);
+    // mirrored[i] = mirror_signs[i] * row[mirror_permutation[i]], built from the features on the first mirrored search.
+    std::vector<int32_t> mirror_permutation{};
+    std::vector<float> mirror_signs{};
+
+    // Also search the poses played at these rates, 1.0 being the baked animation, without baking them :
+    // the dimensions depending on the rate (velocities, trajectory offsets) are rescaled in the query.
+    // query_pose returns the rate of the best pose, to set as the speed_scale of the player, see MMAnimationPlayer::request_match.
+    PackedFloat32Array playback_rates{};
+    PackedFloat32Array get_playback_rates(){return playback_rates;}
+    void set_playback_rates(PackedFloat32Array value)
+    {
+        playback_rates.clear();
+        for (const float rate : value)
         {
-            if(kdt != nullptr)
-                delete kdt;
-            kdt = nullptr;
+            ERR_CONTINUE_MSG(rate <= 0.0f, "Playback rates must be positive");
+            playback_rates.push_back(rate);
         }
-        if(kdt == nullptr)
+    }
+    // A row played at rate r has row[i] * r^rate_exponents[i], built from the features on the first search with rates.
+    std::vector<float> rate_exponents{};
+
+    // Coarser databases derived from the full one, for the characters that don't need its resolution (far away...).
+    // LOD n (from 1) keeps one row out of lod_row_steps[n - 1] in each animation, and only the dimensions of the features
+    // at the indices of lod_features[n - 1] (all of them when missing or empty). The query picks the LOD, 0 being the full database.
+    // Each LOD has its own index, built on a worker thread on its first query and rebuilt when the database or the weights change.
+    // The previous LOD index is used until the new one is ready, and the full database until the first one is.
+    PackedInt32Array lod_row_steps{};
+    PackedInt32Array get_lod_row_steps(){return lod_row_steps;}
+    void set_lod_row_steps(PackedInt32Array value){lod_row_steps = value; _clear_lods();}
+    Array lod_features{};
+    Array get_lod_features(){return lod_features;}
+    void set_lod_features(Array value){lod_features = value; _clear_lods();}
+
+    struct LodDatabase
+    {
+        std::vector<int64_t> rows{}; // Row of the library of each LOD row.
+        std::vector<int32_t> dimensions{}; // Dimension of the library of each LOD dimension.
+        std::shared_ptr<MMDatabaseIndex> index{};
+    };
+    // Input of the LOD task, copied when the task starts, and its result. The task only touches this.
+    struct LodBuild
+    {
+        PackedFloat32Array data{};
+        PackedInt32Array anim_index{};
+        PackedInt32Array categories{};
+        PackedFloat32Array row_biases{};
+        std::vector<float> animation_biases{};
+        PackedFloat32Array weights{}; // By LOD dimension.
+        int32_t nb_dimensions = 0;
+        int distance_type = 1;
+        int32_t step = 1;
+        std::shared_ptr<LodDatabase> result{};
+    };
+    struct LodSlot
+    {
+        std::shared_ptr<const LodDatabase> database{}; // Published, may be built for an older generation.
+        std::unique_ptr<LodBuild> build{};
+        int64_t task_id = -1;
+        uint64_t started_generation = std::numeric_limits<uint64_t>::max(); // index_generation of the last task.
+    };
+    std::vector<LodSlot> lod_slots{}; // By LOD - 1.
+
+    void _clear_lods()
+    {
+        for (const LodSlot& slot : lod_slots)
         {
-            fill_kdtree();
+            if (slot.task_id != -1)
+            {
+                WorkerThreadPool::get_singleton()->wait_for_task_completion(slot.task_id);
+            }
         }
+        lod_slots.clear();
+    }
+
+    // The rows changed : the current index can't be used anymore, nor the rows of the LOD databases.
+    void invalidate_index()
+    {
+        animation_row_ranges.clear();
+        _clear_lods();
+        ++index_generation;
+        std::atomic_store(&index, std::shared_ptr<MMDatabaseIndex>{});
+    }
+
+    // The rows didn't move (only the distance changed, or segments need a merge) :
+    // the current index stays valid until the new one replaces it.
+    void _rebuild_index_in_background()
+    {
+        ++index_generation;
+        if (get_index_snapshot() != nullptr && async_index_build && index_task_id == -1)
+        {
+            build_index(true);
+        }
+    }
+
+    // Index usable from any thread, nullptr if there is none. It may be built with older weights.
+    std::shared_ptr<MMDatabaseIndex> get_index_snapshot() const
+    {
+        return std::atomic_load(&index);
+    }
+
+    bool _is_index_current() const
+    {
+        return get_index_snapshot() != nullptr && published_generation == index_generation;
     }
 
-    void fill_kdtree()
+    void _publish(const std::shared_ptr<MMDatabaseIndex>& result, uint64_t generation)
+    {
+        std::atomic_store(&index, result);
+        published_generation = generation;
+        u::prints("MMAL index ready", result->get_row_count(), "poses");
+        emit_signal("index_ready");
+    }
+
+    void _wait_index_task()
+    {
+        if (index_task_id != -1)
+        {
+            WorkerThreadPool::get_singleton()->wait_for_task_completion(index_task_id);
+            index_task_id = -1;
+        }
+    }
+
+    void _build_index_task()
+    {
+        const PackedFloat32Array biases = _combine_biases(index_task_anim_index, index_task_row_biases, index_task_animation_biases);
+        auto result = MMDatabaseRegistry::acquire(index_task_data, index_task_categories, index_task_dimensions, index_task_distance_type, index_task_weights, biases);
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            built_index = result;
+        }
+        call_deferred("_publish_index");
+    }
+
+    // Main thread side of the index task : takes its result once it's done, waiting for it if asked.
+    // A result built from an older generation is dropped, and a new task is started if the index is still needed.
+    void _collect_index_task(bool wait)
+    {
+        if (index_task_id == -1 || (!wait && !WorkerThreadPool::get_singleton()->is_task_completed(index_task_id)))
+        {
+            return;
+        }
+        _wait_index_task();
+        std::shared_ptr<MMDatabaseIndex> result{};
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            result.swap(built_index);
+        }
+        if (result != nullptr && building_generation == index_generation)
+        {
+            _publish(result, building_generation);
+        }
+        index_task_data = {}; index_task_categories = {}; index_task_weights = {};
+        index_task_anim_index = {};
+        index_task_row_biases = {}; index_task_animation_biases.clear();
+        if (result != nullptr && building_generation == index_generation)
+        {
+            return;
+        }
+        else if (!wait && get_index_snapshot() != nullptr && !_is_index_current())
+        {
+            // Still serving an outdated index, build the up to date one.
+            build_index(true);
+        }
+    }
+
+    void _publish_index()
+    {
+        _collect_index_task(false);
+    }
+
+    // Build the search index, now or on a worker thread.
+    void build_index(bool asynchronous = false)
     {
-        u::prints("MF size",motion_features.size());
         ERR_FAIL_COND_EDMSG(nb_dimensions == 0,"Number Dimensions is zero");
         ERR_FAIL_COND_EDMSG(MotionData.is_empty(),"Motion Data is Empty");
+        ERR_FAIL_COND_EDMSG(MotionData.size() != db_anim_category.size() * nb_dimensions,"Motion Data doesn't match the categories");
+        if (asynchronous && index_task_id != -1 && building_generation == index_generation)
+        {
+            return; // Already building this one.
+        }
+        _collect_index_task(true);
+        if (_is_index_current())
+        {
+            return;
+        }
+        building_generation = index_generation;
+        if (!asynchronous)
+        {
+            auto result = MMDatabaseRegistry::acquire(MotionData, db_anim_category, nb_dimensions, distance_type, weights, _row_biases());
+            if (result != nullptr)
+            {
+                _publish(result, building_generation);
+            }
+            return;
+        }
+        index_task_data = MotionData;
+        index_task_categories = db_anim_category;
+        index_task_anim_index = db_anim_index;
+        index_task_row_biases = db_anim_bias;
+        index_task_animation_biases = _animation_bias_table();
+        index_task_weights = weights;
+        index_task_dimensions = nb_dimensions;
+        index_task_distance_type = distance_type;
+        index_task_id = WorkerThreadPool::get_singleton()->add_task(Callable(this, "_build_index_task"), false, "MMAnimationLibrary index");
+    }
+
+    // Index to use for a query from the main thread, nullptr while the first one is built on a worker thread.
+    // With wait, the index is up to date with the current weights and distance.
+    std::shared_ptr<MMDatabaseIndex> _get_index(bool wait = false)
+    {
+        _collect_index_task(false);
+        if (!_is_index_current() && (wait || !async_index_build))
+        {
+            build_index(false);
+        }
+        else if (get_index_snapshot() == nullptr && index_task_id == -1)
+        {
+            build_index(true);
+        }
+        return get_index_snapshot();
+    }
 
-        u::prints("Total Dimension", nb_dimensions);
-        if(kdt != nullptr)
-            delete kdt;
+    // Search used while the index isn't ready. Returns the k nearest rows accepted by pred, closest first.
+    void _brute_force_search(const float* query, size_t k, std::vector<int64_t>& rows, const Kdtree::KdNodePredicate* pred = nullptr, std::vector<float>* distances = nullptr, const float* custom_weights = nullptr) const
+    {
+        std::vector<std::pair<float, int64_t>> best{};
+        const int64_t row_count = db_anim_category.size();
+        const PackedFloat32Array biases = _combine_biases(db_anim_index, db_anim_bias, _animation_bias_table());
+        Kdtree::KdNode node{};
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            if (db_anim_category[row] & MMDatabaseIndex::removed_category_bit)
+            {
+                continue;
+            }
+            if (pred != nullptr)
+            {
+                node.data = (void*)&db_anim_category.ptr()[row];
+                node.index = row;
+                if (!(*pred)(node))
+                {
+                    continue;
+                }
+            }
+            const float bias = biases.is_empty() ? 0.0f : biases[row];
+            best.emplace_back(_pose_distance(query, MotionData.ptr() + row * nb_dimensions, custom_weights) + bias, row);
+        }
+        k = std::min(k, best.size());
+        std::partial_sort(best.begin(), best.begin() + k, best.end());
+        rows.clear();
+        if (distances != nullptr)
+        {
+            distances->clear();
+        }
+        for (size_t i = 0; i < k; ++i)
+        {
+            rows.push_back(best[i].second);
+            if (distances != nullptr)
+            {
+                distances->push_back(best[i].first);
+            }
+        }
+    }
 
-        // Now we bake all the data
-        u::prints("Preparing kdtree");
-        Kdtree::KdNodeVector nodes{};
-        for(size_t i = 0; i < MotionData.size()/nb_dimensions; ++i)
+    // k nearest rows with search_index, or the brute force search when it's null.
+    // Only reads the library, so it can run on a worker thread as long as the library isn't modified meanwhile.
+    // custom_weights, if any, replace the weights for this search (nb_dimensions values, read in place).
+    void _search_with(const std::shared_ptr<MMDatabaseIndex>& search_index, const float* query, size_t k, std::vector<int64_t>& rows, const Kdtree::KdNodePredicate* pred = nullptr, std::vector<float>* distances = nullptr, const float* custom_weights = nullptr) const
+    {
+        if (search_index != nullptr)
+        {
+            search_index->k_nearest_rows(query, k, rows, pred, distances, custom_weights);
+        }
+        else
         {
-            auto begin = MotionData.ptr(), end = MotionData.ptr(); // We use the ptr as iterator.
-            begin = std::next(begin,nb_dimensions * i);
-            end = std::next(begin,nb_dimensions);
-            std::vector<float> point(begin,end);
-            nodes.push_back(Kdtree::KdNode(std::move(point),&db_anim_category[i],i));
+            _brute_force_search(query, k, rows, pred, distances, custom_weights);
         }
-        u::prints("Creating kdtree");
-        kdt = new Kdtree::KdTree(&nodes,distance_type);
+    }
 
-        weights.resize(nb_dimensions);
+    // k nearest rows with the index, or the brute force search while it's built.
+    void _search(const float* query, size_t k, std::vector<int64_t>& rows, Kdtree::KdNodePredicate* pred = nullptr, bool wait_index = false, const float* custom_weights = nullptr)
+    {
+        _search_with(_get_index(wait_index), query, k, rows, pred, nullptr, custom_weights);
+    }
 
-        auto begin = weights.ptr(), end = weights.ptr(); // We use the ptr as iterator.
-        begin = std::next(begin,0);
-        end =   std::next(begin,nb_dimensions);
-        const std::vector<float> tmp_weight(begin,end);
+    bool is_index_ready() { return get_index_snapshot() != nullptr; }
 
-        kdt->set_distance(distance_type,&tmp_weight);
-        u::prints("KDTree Constructed");
+    // Bias of each animation of animation_biases, by db_anim_index.
+    std::vector<float> _animation_bias_table() const
+    {
+        const Array names = baked_animation_names.is_empty() ? Array(get_animation_list()) : baked_animation_names;
+        std::vector<float> table(names.size(), 0.0f);
+        if (!animation_biases.is_empty())
+        {
+            for (int64_t i = 0; i < names.size(); ++i)
+            {
+                table[i] = animation_biases.get(names[i], 0.0f);
+            }
+        }
+        return table;
+    }
+
+    // Bias of every row given to the index, empty when no row has one so the search skips them.
+    // row_biases is ignored when it doesn't match the rows (libraries baked before the biases).
+    static PackedFloat32Array _combine_biases(const PackedInt32Array& anim_index, const PackedFloat32Array& row_biases, const std::vector<float>& animation_biases)
+    {
+        const int64_t row_count = anim_index.size();
+        const bool has_row_biases = row_biases.size() == row_count && std::any_of(row_biases.ptr(), row_biases.ptr() + row_count, [](float bias){ return bias != 0.0f; });
+        const bool has_animation_biases = std::any_of(animation_biases.begin(), animation_biases.end(), [](float bias){ return bias != 0.0f; });
+        PackedFloat32Array result{};
+        if (!has_row_biases && !has_animation_biases)
+        {
+            return result;
+        }
+        result.resize(row_count);
+        float* write = result.ptrw();
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            const int32_t anim = anim_index[row];
+            write[row] = (has_row_biases ? row_biases[row] : 0.0f) + (0 <= anim && anim < (int64_t)animation_biases.size() ? animation_biases[anim] : 0.0f);
+        }
+        return result;
+    }
+
+    PackedFloat32Array _row_biases() const
+    {
+        return _combine_biases(db_anim_index, db_anim_bias, _animation_bias_table());
+    }
+
+    // Incremental bake : hash of everything that changes the features (features, profile, sampling),
+    // and hash of each animation content when it was baked. Animations are stored in the bake order,
+    // so the index of a key is the db_anim_index used by its rows.
+    GETSET(int64_t,baked_configuration_hash,0);
+    Dictionary baked_animation_hashes{};
+    Dictionary get_baked_animation_hashes(){return baked_animation_hashes;}
+    void set_baked_animation_hashes(Dictionary value){baked_animation_hashes = value; baked_animation_names = value.keys(); _invalidate_animation_table();}
+    Array baked_animation_names{}; // Keys of baked_animation_hashes, by db_anim_index.
+
+    // Name and animation of each db_anim_index, built on the first lookup so the queries don't go through
+    // get_animation_list(). Cleared when an animation is added, removed or renamed, and when the baked animations change.
+    std::vector<StringName> animation_name_table{};
+    std::vector<Ref<Animation>> animation_table{};
+
+    void _invalidate_animation_table()
+    {
+        animation_name_table.clear();
+        animation_table.clear();
+    }
+
+    void _build_animation_table()
+    {
+        if (!animation_name_table.empty())
+        {
+            return;
+        }
+        // Libraries baked before the hashes existed use the animation list order.
+        const Array names = baked_animation_names.is_empty() ? Array(get_animation_list()) : baked_animation_names;
+        animation_name_table.resize(names.size());
+        animation_table.resize(names.size());
+        for (int64_t i = 0; i < names.size(); ++i)
+        {
+            animation_name_table[i] = names[i];
+            animation_table[i] = has_animation(animation_name_table[i]) ? get_animation(animation_name_table[i]) : Ref<Animation>();
+        }
+    }
+
+    // Name of the animation of a row.
+    StringName get_row_animation_name(int64_t row)
+    {
+        ERR_FAIL_INDEX_V(row, db_anim_index.size(), StringName());
+        const int32_t anim_index = db_anim_index[row];
+        _build_animation_table();
+        ERR_FAIL_INDEX_V(anim_index, (int64_t)animation_name_table.size(), StringName());
+        return animation_name_table[anim_index];
+    }
+
+    Ref<Animation> get_row_animation(int64_t row)
+    {
+        ERR_FAIL_INDEX_V(row, db_anim_index.size(), Ref<Animation>());
+        const int32_t anim_index = db_anim_index[row];
+        _build_animation_table();
+        ERR_FAIL_INDEX_V(anim_index, (int64_t)animation_table.size(), Ref<Animation>());
+        return animation_table[anim_index];
     }
 
+    static constexpr uint64_t hash_seed = 0xcbf29ce484222325ULL;
+    static uint64_t _hash_combine(uint64_t hash, uint64_t value)
+    {
+        // FNV-1a on 64 bits words.
+        hash ^= value;
+        hash *= 0x100000001b3ULL;
+        return hash;
+    }
 
-    
-    
+    // Variant::hash() is stable between sessions, except for objects where it's the instance id.
+    // Resources are hashed through their stored properties instead.
+    static uint64_t _hash_variant(const Variant& value, uint64_t hash = hash_seed, int depth = 0)
+    {
+        if (value.get_type() != Variant::OBJECT)
+        {
+            return _hash_combine(hash, value.hash());
+        }
+        const Object* object = value;
+        if (object == nullptr || depth > 2)
+        {
+            return _hash_combine(hash, 0);
+        }
+        hash = _hash_combine(hash, String(object->get_class()).hash());
+        const TypedArray<Dictionary> properties = object->get_property_list();
+        for (int64_t i = 0; i < properties.size(); ++i)
+        {
+            const Dictionary property = properties[i];
+            if (((int64_t)property["usage"] & PROPERTY_USAGE_STORAGE) == 0)
+            {
+                continue;
+            }
+            const StringName name = property["name"];
+            hash = _hash_combine(hash, String(name).hash());
+            hash = _hash_variant(object->get(name), hash, depth + 1);
+        }
+        return hash;
+    }
 
-    void bake_data()
+    uint64_t _hash_configuration()
     {
-        ERR_FAIL_COND_EDMSG(motion_features.is_empty(),"No Motion Features to extract data");
-        ERR_FAIL_COND_EDMSG(skeleton_profile == nullptr,"Skeleton_profile is empty");
-        ERR_FAIL_COND_EDMSG(skeleton_profile->get_root_bone().is_empty(),"SkeletonProfile requires a Root Bone");
+        uint64_t hash = hash_seed;
+        hash = _hash_variant(skeleton_path, hash);
+        hash = _hash_variant(skeleton_profile, hash);
+        hash = _hash_variant(time_interval, hash);
+        hash = _hash_variant(adaptive_sampling, hash);
+        if (adaptive_sampling)
+        {
+            hash = _hash_variant(adaptive_interval, hash);
+            hash = _hash_variant(adaptive_threshold, hash);
+            hash = _hash_variant(adaptive_max_gap, hash);
+            hash = _hash_variant(distance_type, hash);
+            hash = _hash_variant(weights, hash);
+        }
+        hash = _hash_variant(category_track_names, hash);
+        hash = _hash_variant(bias_track_name, hash);
+        for (auto i = 0; i < motion_features.size(); ++i)
+        {
+            hash = _hash_variant(motion_features[i], hash);
+        }
+        return hash;
+    }
+
+    // Only the keys are hashed. The interpolation of category tracks is changed by the bake itself.
+    static uint64_t _hash_animation(const Ref<Animation>& animation)
+    {
+        uint64_t hash = hash_seed;
+        hash = _hash_variant(animation->get_length(), hash);
+        hash = _hash_combine(hash, animation->get_loop_mode());
+        for (int32_t track = 0; track < animation->get_track_count(); ++track)
+        {
+            hash = _hash_combine(hash, animation->track_get_type(track));
+            hash = _hash_variant(animation->track_get_path(track), hash);
+            // They change the sampled values as much as the keys.
+            hash = _hash_combine(hash, animation->track_get_interpolation_type(track));
+            hash = _hash_combine(hash, animation->track_get_interpolation_loop_wrap(track));
+            hash = _hash_combine(hash, animation->track_is_enabled(track));
+            const int32_t key_count = animation->track_get_key_count(track);
+            hash = _hash_combine(hash, key_count);
+            for (int32_t key = 0; key < key_count; ++key)
+            {
+                hash = _hash_variant(animation->track_get_key_time(track, key), hash);
+                hash = _hash_variant(animation->track_get_key_value(track, key), hash);
+            }
+        }
+        return hash;
+    }
+
+    // Setup the features and sum their dimensions, returns false if a feature can't be used.
+    // Only bake_data gives nb_dimensions : elsewhere the sum is compared to the baked dimensions.
+    bool _setup_features(int& dimensions)
+    {
+        ERR_FAIL_COND_V_EDMSG(motion_features.is_empty(), false, "No Motion Features to extract data");
+        ERR_FAIL_COND_V_EDMSG(skeleton_profile == nullptr, false, "Skeleton_profile is empty");
+        ERR_FAIL_COND_V_EDMSG(skeleton_profile->get_root_bone().is_empty(), false, "SkeletonProfile requires a Root Bone");
         u::prints("Preparing Features...");
         size_t tmp_nb_dim = 0;
         for(auto i = 0; i < motion_features.size(); ++i )
         {
             MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[i]);
-            ERR_FAIL_NULL_MSG(f,"Features no."+u::str(i) + "is null");
+            ERR_FAIL_NULL_V_MSG(f, false, "Features no."+u::str(i) + "is null");
             u::prints("Feature no.",i,f->get_name(),"Dimensions:", f->get_dimension());
             if (false == f->setup_profile(NodePath(skeleton_path),skeleton_profile) )
             {
-                ERR_FAIL_EDMSG("Motion Feature failed when setting the profile at index " + u::str(i));
+                ERR_FAIL_V_EDMSG(false, "Motion Feature failed when setting the profile at index " + u::str(i));
             }
             tmp_nb_dim += (int)(f->get_dimension());
         }
-        nb_dimensions = tmp_nb_dim;
-        u::prints("Total Dimension", nb_dimensions);
+        dimensions = tmp_nb_dim;
+        u::prints("Total Dimension", dimensions);
+        skeleton_sampler.setup_profile(NodePath(skeleton_path),skeleton_profile);
+        return true;
+    }
 
-        godot::TypedArray<godot::StringName> anim_names = get_animation_list();
-        u::prints("Detecting",anim_names.size(),"animations. Preparing...");
-        
-        means.clear(); means.resize(nb_dimensions); means.fill(0.0f);
-        variances.clear();variances.resize(nb_dimensions); variances.fill(0.0f);
-        densities.clear();densities.resize(nb_dimensions); densities.fill(Array::make(0.0,0.0));
+    void _set_features_sampler(SkeletonSampler* sampler)
+    {
+        for(auto i = 0; i < motion_features.size(); ++i )
+        {
+            Object::cast_to<MotionFeature>(motion_features[i])->set_skeleton_sampler(sampler);
+        }
+    }
 
-        PackedFloat32Array data = PackedFloat32Array();
-        
+    // Bake the rows of one animation at the end of data and the db_anim_* arrays.
+    // Returns the number of rows, or -1 when a feature failed.
+    int64_t _bake_animation(int32_t anim_index, const Ref<Animation>& animation, PackedFloat32Array& data)
+    {
+        skeleton_sampler.setup_for_animation(animation);
+
+        int should_continue = -1;
+        for(auto features_index = 0; features_index < motion_features.size(); ++features_index )
+        {
+            MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            if( false == f->setup_for_animation(animation))
+            {
+                should_continue = features_index;
+                break;
+            }
+        }
+        if (should_continue != -1)
+        {
+            WARN_PRINT_ED("Skipping Animation '" + animation->get_name() + "' because of motion feature index :" + u::str(should_continue));
+            return 0;
+        }
+
+        std::vector<int32_t> category_tracks{};
+        for(auto i = 0 ; i<category_track_names.size();++i)
+        {
+            auto category_track = animation->find_track((String)category_track_names[i],Animation::TrackType::TYPE_VALUE);
+            if (category_track != -1)
+            {
+                animation->value_track_set_update_mode(category_track,Animation::UpdateMode::UPDATE_DISCRETE);
+                animation->track_set_interpolation_type(category_track,Animation::InterpolationType::INTERPOLATION_NEAREST);
+                category_tracks.push_back(category_track);
+            }
+            u::prints("Checking Category Track",category_track_names[i], "result:",category_track != -1);
+        }
+
+        const int32_t bias_track = bias_track_name.is_empty() ? -1 : animation->find_track(NodePath(bias_track_name),Animation::TrackType::TYPE_VALUE);
+
+        const auto length = animation->get_loop_mode() == Animation::LOOP_NONE ? animation->get_length() - 0.2 : animation->get_length() ;
+
+        u::prints("Animations setup for",animation->get_name(),"duration",length);
+
+        // Times, categories and biases of the rows.
+        PackedFloat32Array times{};
+        PackedInt32Array categories{};
+        PackedFloat32Array biases{};
+        const float interval = adaptive_sampling ? adaptive_interval : time_interval;
+        ERR_FAIL_COND_V_EDMSG(interval <= 0.0f, -1, "The sampling interval must be positive");
+        for(auto time = interval; time < length; time += interval)
+        {
+            int64_t tmp_category_value = 0;
+            for(const auto& category:category_tracks)
+            {
+                tmp_category_value = tmp_category_value | (int64_t)animation->value_track_interpolate(category,time);
+            }
+            // If the reserved category value contain DONOTUSE (31th bit set to true), then we skip.
+            if (std::bitset<64>(tmp_category_value).test(31))
+            {
+                continue;
+            }
+            times.push_back(time);
+            categories.push_back(tmp_category_value);
+            biases.push_back(bias_track != -1 ? (float)animation->value_track_interpolate(bias_track,time) : 0.0f);
+        }
+
+        // Every feature writes its columns straight into the data, by chunks so the skeleton poses stay small.
+        const int64_t row_count = times.size();
+        const int64_t first_row = db_anim_index.size();
+        data.resize((first_row + row_count) * nb_dimensions);
+        constexpr int64_t chunk_size = 256;
+        std::vector<double> chunk_times{};
+        for(int64_t chunk_begin = 0; chunk_begin < row_count; chunk_begin += chunk_size)
+        {
+            const int64_t chunk_end = std::min(chunk_begin + chunk_size, row_count);
+            const PackedFloat32Array chunk = times.slice(chunk_begin, chunk_end);
+            chunk_times.assign(chunk.ptr(), chunk.ptr() + chunk.size());
+            // Evaluated once, every feature reads the same poses.
+            skeleton_sampler.evaluate(chunk_times.data(), chunk_times.size());
+
+            float* out = data.ptrw() + (first_row + chunk_begin) * nb_dimensions;
+            for(size_t features_index = 0; features_index < motion_features.size(); ++features_index )
+            {
+                MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+                const bool baked = f->bake_animation_range(animation, chunk, out, nb_dimensions);
+                ERR_FAIL_COND_V_MSG(!baked, -1, String("Features no.") + u::str(int(features_index))+" failed to bake the animation.");
+                out += f->get_dimension();
+            }
+        }
+
+        const int64_t kept_count = adaptive_sampling ? _keep_adaptive_rows(data.ptrw() + first_row * nb_dimensions, times, categories, biases) : row_count;
+        data.resize((first_row + kept_count) * nb_dimensions);
+
+        db_anim_index.resize(first_row + kept_count);
+        db_anim_timestamp.resize(first_row + kept_count);
+        db_anim_category.resize(first_row + kept_count);
+        std::fill_n(db_anim_index.ptrw() + first_row, kept_count, anim_index);
+        std::copy_n(times.ptr(), kept_count, db_anim_timestamp.ptrw() + first_row);
+        std::copy_n(categories.ptr(), kept_count, db_anim_category.ptrw() + first_row);
+        // Libraries baked before the biases have none for the previous rows.
+        const int64_t bias_begin = std::min<int64_t>(db_anim_bias.size(), first_row);
+        db_anim_bias.resize(first_row + kept_count);
+        std::fill(db_anim_bias.ptrw() + bias_begin, db_anim_bias.ptrw() + first_row, 0.0f);
+        std::copy_n(biases.ptr(), kept_count, db_anim_bias.ptrw() + first_row);
+        return kept_count;
+    }
 
-        db_anim_category.clear();db_anim_index.clear();db_anim_timestamp.clear();
+    // Weight of the dimension, 1 when the weights don't match the dimensions.
+    float _weight(int32_t dimension) const
+    {
+        return weights.size() == nb_dimensions ? weights[dimension] : 1.0f;
+    }
+
+    // Weighted distance between two rows, the same the kdtree uses for distance_type.
+    // custom_weights replace the weights if any. Weights are ignored when they don't match the dimensions.
+    float _pose_distance(const float* a, const float* b, const float* custom_weights = nullptr) const
+    {
+        float result = 0.0f;
+        for (int i = 0; i < nb_dimensions; ++i)
+        {
+            const float w = custom_weights != nullptr ? custom_weights[i] : _weight(i);
+            const float d = std::abs(a[i] - b[i]);
+            switch (distance_type)
+            {
+            case 0: result = std::max(result, w * d); break;
+            case 2: result += w * d * d; break;
+            default: result += w * d; break;
+            }
+        }
+        return result;
+    }
+
+    // Adaptive sampling of the candidate rows of one animation, rows are compacted at the front of data.
+    // times, categories and biases are compacted the same way. Returns the number of rows kept.
+    int64_t _keep_adaptive_rows(float* data, PackedFloat32Array& times, PackedInt32Array& categories, PackedFloat32Array& biases) const
+    {
+        const int64_t row_count = times.size();
+        int64_t kept = 0;
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            if (kept > 0)
+            {
+                const int64_t last = kept - 1;
+                const bool moved = _pose_distance(data + row * nb_dimensions, data + last * nb_dimensions) > adaptive_threshold;
+                const bool too_far = times[row] - times[last] >= adaptive_max_gap;
+                const bool category_changed = categories[row] != categories[last];
+                if (!moved && !too_far && !category_changed)
+                {
+                    continue;
+                }
+            }
+            if (kept != row)
+            {
+                std::copy_n(data + row * nb_dimensions, nb_dimensions, data + kept * nb_dimensions);
+                times.set(kept, times[row]);
+                categories.set(kept, categories[row]);
+                biases.set(kept, biases[row]);
+            }
+            ++kept;
+        }
+        times.resize(kept);
+        categories.resize(kept);
+        biases.resize(kept);
+        return kept;
+    }
 
+    // Compute means, variances and densities of every dimension of MotionData.
+    void _compute_statistics()
+    {
         using namespace boost::accumulators;
         using acc_stats = stats<tag::density,tag::max,tag::min,tag::median,tag::skewness,tag::variance>;
         const accumulator_set<float,acc_stats> default_acc (tag::density::num_bins = 10, tag::density::cache_size = 15);
         std::vector<accumulator_set<float,acc_stats>> data_stats(nb_dimensions,default_acc);
 
-        u::prints("Starting animation baking...");
+        means.clear(); means.resize(nb_dimensions); means.fill(0.0f);
+        variances.clear();variances.resize(nb_dimensions); variances.fill(0.0f);
+        densities.clear();densities.resize(nb_dimensions); densities.fill(Array::make(0.0,0.0));
+
+        const float* data = MotionData.ptr();
+        const int64_t row_count = nb_dimensions == 0 ? 0 : MotionData.size() / nb_dimensions;
+        for(int64_t row = 0; row < row_count; ++row)
+        {
+            for(int i = 0; i<nb_dimensions;++i)
+            {
+                data_stats[i](data[row * nb_dimensions + i]);
+            }
+        }
 
+        for(auto i = 0; i< nb_dimensions;++i)
+        {
+            means[i] = mean(data_stats[i]);
+            variances[i] = variance(data_stats[i]);
+            if (variances[i] <= std::numeric_limits<float>::epsilon() )
+            {
+                variances[i] = 1.0f;
+            }
+            Array arr{};
+            for(const auto& d : density(data_stats[i]))
+            {
+                arr.append(Array::make(d.first,d.second) ); 
+            }
+            densities[i] = std::move(arr);
+        }
+    }
+
+    // Bake the whole library. Animations whose content didn't change since the last bake keep their rows,
+    // unless the features configuration changed or force_full_bake is set.
+    void bake_data(bool force_full_bake = false)
+    {
+        mirror_permutation.clear();
+        mirror_signs.clear();
+        rate_exponents.clear();
+        if (!_setup_features(nb_dimensions))
+        {
+            return;
+        }
+
+        const int64_t configuration_hash = (int64_t)_hash_configuration();
+        const bool reuse_rows = !force_full_bake 
+                                && configuration_hash == baked_configuration_hash 
+                                && nb_dimensions > 0
+                                && !MotionData.is_empty()
+                                && MotionData.size() == db_anim_index.size() * nb_dimensions;
+
+        // Rows of the previous bake, by their previous animation index.
+        const PackedFloat32Array old_data = MotionData;
+        const PackedInt32Array old_index = db_anim_index;
+        const PackedFloat32Array old_timestamp = db_anim_timestamp;
+        const PackedInt32Array old_category = db_anim_category;
+        const PackedFloat32Array old_bias = db_anim_bias;
+        const Array old_names = baked_animation_hashes.keys();
+        std::vector<std::vector<int64_t>> old_rows(old_names.size());
+        if (reuse_rows)
+        {
+            for (int64_t row = 0; row < old_index.size(); ++row)
+            {
+                if (0 <= old_index[row] && old_index[row] < (int64_t)old_rows.size())
+                {
+                    old_rows[old_index[row]].push_back(row);
+                }
+            }
+        }
+
+        _set_features_sampler(&skeleton_sampler);
+
+        godot::TypedArray<godot::StringName> anim_names = get_animation_list();
+        u::prints("Detecting",anim_names.size(),"animations. Preparing...");
+
+        PackedFloat32Array data = PackedFloat32Array();
+        db_anim_category.clear();db_anim_index.clear();db_anim_timestamp.clear();db_anim_bias.clear();
+        Dictionary animation_hashes{};
+
+        u::prints("Starting animation baking...");
+        int64_t reused_count = 0;
         for(auto anim_index = 0; anim_index < anim_names.size(); ++anim_index)
         {
             auto clock_start = std::chrono::system_clock::now();
 
-            auto anim_name = anim_names[anim_index];
+            const StringName anim_name = anim_names[anim_index];
             auto animation = get_animation(anim_name);
+            const int64_t animation_hash = (int64_t)_hash_animation(animation);
+            animation_hashes[anim_name] = animation_hash;
 
-            int should_continue = -1;
-            for(auto features_index = 0; features_index < motion_features.size(); ++features_index )
+            const int64_t old_anim_index = old_names.find(anim_name);
+            if (reuse_rows && old_anim_index != -1 && (int64_t)baked_animation_hashes[anim_name] == animation_hash)
             {
-                MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
-                if( false == f->setup_for_animation(animation))
+                for (const int64_t row : old_rows[old_anim_index])
                 {
-                    should_continue = features_index;
-                    break;
+                    data.append_array(old_data.slice(row * nb_dimensions, (row + 1) * nb_dimensions));
+                    db_anim_index.append(anim_index);
+                    db_anim_timestamp.append(old_timestamp[row]);
+                    db_anim_category.append(old_category[row]);
+                    db_anim_bias.append(old_bias.size() == old_index.size() ? old_bias[row] : 0.0f);
                 }
-            }
-            if (should_continue != -1)
-            {
-                WARN_PRINT_ED("Skipping Animation '" + (String)anim_name + "' because of motion feature index :" + u::str(should_continue));
+                ++reused_count;
+                u::prints("Reusing animation data from", anim_name, "PoseCount", (int64_t)old_rows[old_anim_index].size());
                 continue;
             }
-            // ERR_CONTINUE_EDMSG(should_continue != -1,);
 
-            std::vector<int32_t> category_tracks{};
-            for(auto i = 0 ; i<category_track_names.size();++i)
+            const int64_t counter = _bake_animation(anim_index, animation, data);
+            if (counter < 0)
             {
-                 auto category_track = animation->find_track((String)category_track_names[i],Animation::TrackType::TYPE_VALUE);
-                 animation->value_track_set_update_mode(category_track,Animation::UpdateMode::UPDATE_DISCRETE);
-                 animation->track_set_interpolation_type(category_track,Animation::InterpolationType::INTERPOLATION_NEAREST);
-                 if (category_track != -1)
-                 {
-                    category_tracks.push_back(category_track);                    
-                 }
-                 u::prints("Checking Category Track",category_track_names[i], "result:",category_track != -1);
+                _set_features_sampler(nullptr);
+                ERR_FAIL_EDMSG("Baking failed for animation '" + String(anim_name) + "'");
             }
+            auto clock_end = std::chrono::system_clock::now();
+            float duration = float(std::chrono::duration_cast <std::chrono::milliseconds> (clock_end - clock_start).count());
+            u::prints("Collecting animation data from ",animation->get_name(), " in ", duration, "ms. PoseCount",counter);
+        }
 
-            const auto length = animation->get_loop_mode() == Animation::LOOP_NONE ? animation->get_length() - 0.2 : animation->get_length() ;
+        _set_features_sampler(nullptr);
+        u::prints("Animation Data Collected.", reused_count, "animations reused. Normalizing... ");
 
-            u::prints("Animations setup for",anim_name,"duration",length);
+        // // Normalization
+        // for(size_t pose = 0; pose < data.size()/nb_dimensions; ++pose)
+        // {
+        //     for(int offset = 0; offset<nb_dimensions;++offset)
+        //     {
+        //         data[pose*nb_dimensions + offset] = (data[pose*nb_dimensions + offset] - means[offset])/variances[offset]; 
+        //     }
+        // }
+
+        MotionData = data.duplicate();
+        invalidate_index();
+        _compute_statistics();
+        u::prints("Data Normalized. Copied data to Motion Data property...");
 
-            auto counter = 0;
-            for(auto time = time_interval; time < length; time += time_interval)
+        baked_configuration_hash = configuration_hash;
+        set_baked_animation_hashes(animation_hashes);
+
+        if(weights.size() != nb_dimensions)
+        {
+            WARN_PRINT_ED("Weights resized to " + u::str(nb_dimensions)+ " and reset to ones.");
+            weights.resize(nb_dimensions);
+            weights.fill(1.0);
+        }
+
+        _bake_continuations();
+
+        if (!database_path.is_empty())
+        {
+            save_database();
+        }
+
+        u::prints("Finished All Animations");
+        u::prints("NbDim",nb_dimensions,"NbPoses:",data.size()/nb_dimensions,"Size",data.size());
+    }
+
+    void _bake_continuations()
+    {
+        continuations.clear();
+        if (!bake_continuations || continuation_count <= 0)
+        {
+            return;
+        }
+        const auto search_index = _get_index(true);
+        const Category_Pred pred(continuation_included_category, continuation_excluded_category);
+        _build_animation_table();
+        std::vector<int64_t> rows{};
+        std::vector<float> distances{};
+        for (int64_t anim_index = 0; anim_index < (int64_t)animation_name_table.size(); ++anim_index)
+        {
+            const Ref<Animation>& animation = animation_table[anim_index];
+            if (animation.is_null() || animation->get_loop_mode() != Animation::LOOP_NONE)
+            {
+                continue; // Looping clips never end.
+            }
+            const auto [first_row, end_row] = _animation_row_range(anim_index);
+            int64_t tail_row = -1;
+            for (int64_t row = end_row - 1; row >= first_row && tail_row == -1; --row)
             {
-                int64_t tmp_category_value = 0;
-                for(const auto& category:category_tracks)
+                if (db_anim_index[row] == anim_index && !(db_anim_category[row] & MMDatabaseIndex::removed_category_bit))
                 {
-                    tmp_category_value = tmp_category_value | (int64_t)animation->value_track_interpolate(category,time);
+                    tail_row = row;
                 }
-                // If the reserved category value contain DONOTUSE (31th bit set to true), then we skip.
-                if (std::bitset<64>(tmp_category_value).test(31))
+            }
+            if (tail_row == -1)
+            {
+                continue;
+            }
+            // The rows of the clip itself are the closest, enough rows are searched to skip them.
+            _search_with(search_index, MotionData.ptr() + tail_row * nb_dimensions, continuation_count + (end_row - first_row), rows, &pred, &distances);
+            Array clip_continuations{};
+            for (size_t i = 0; i < rows.size() && clip_continuations.size() < continuation_count; ++i)
+            {
+                const int32_t continuation_anim = db_anim_index[rows[i]];
+                if (continuation_anim == anim_index || continuation_anim < 0 || continuation_anim >= (int64_t)animation_name_table.size())
                 {
                     continue;
                 }
+                Dictionary continuation{};
+                continuation["animation"] = animation_name_table[continuation_anim];
+                continuation["timestamp"] = db_anim_timestamp[rows[i]];
+                continuation["cost"] = distances[i];
+                clip_continuations.push_back(continuation);
+            }
+            continuations[animation_name_table[anim_index]] = clip_continuations;
+        }
+        u::prints("Continuations baked for", continuations.size(), "animations");
+    }
 
-                PackedFloat32Array pose_data{};
-                for(size_t features_index = 0; features_index < motion_features.size(); ++features_index )
+    // Continuations of an animation baked by bake_data, best first : Array of {animation, timestamp, cost}.
+    Array get_animation_continuations(StringName animation_name)
+    {
+        return continuations.get(animation_name, Array());
+    }
+
+    // Binary database. When database_path is set, the baked arrays are saved in that file instead of the resource,
+    // as aligned little-endian blocks, optionally compressed. Loading is a straight read of each block.
+    // The .mmdb isn't a resource : exported projects must add *.mmdb to the export filter for non-resource files.
+    static constexpr uint32_t database_magic = 0x42444D4D; // "MMDB"
+    static constexpr uint32_t database_version = 2; // 2 : BLOCK_ANIM_BIAS.
+    static constexpr int64_t database_alignment = 16;
+    enum DatabaseBlock : uint32_t
+    {
+        BLOCK_MOTION_DATA,
+        BLOCK_MEANS,
+        BLOCK_VARIANCES,
+        BLOCK_DENSITIES,
+        BLOCK_ANIM_INDEX,
+        BLOCK_ANIM_TIMESTAMP,
+        BLOCK_ANIM_CATEGORY,
+        BLOCK_ANIM_BIAS,
+        BLOCK_COUNT
+    };
+
+    String database_path{};
+    String get_database_path() { return database_path; }
+    void set_database_path(String value)
+    {
+        database_path = value;
+        if (!database_path.is_empty())
+        {
+            if (FileAccess::file_exists(database_path))
+            {
+                load_database();
+            }
+            else if (!MotionData.is_empty())
+            {
+                // Already baked, the arrays leave the resource : write them before it's saved.
+                save_database();
+            }
+            else if (nb_dimensions > 0)
+            {
+                ERR_PRINT_ED("Motion database " + database_path + " is missing. Exported projects must add *.mmdb to the export filter.");
+            }
+        }
+        notify_property_list_changed();
+    }
+
+    // 0 : None, 1 : Zstd, 2 : Deflate.
+    GETSET(int, database_compression, 1);
+
+    static void _pad_to_alignment(const Ref<FileAccess>& file)
+    {
+        while (file->get_position() % database_alignment != 0)
+        {
+            file->store_8(0);
+        }
+    }
+
+    static void _skip_to_alignment(const Ref<FileAccess>& file)
+    {
+        file->seek(((file->get_position() + database_alignment - 1) / database_alignment) * database_alignment);
+    }
+
+    void _store_block(const Ref<FileAccess>& file, DatabaseBlock id, const PackedByteArray& bytes) const
+    {
+        const bool compressed = database_compression != 0 && !bytes.is_empty();
+        const PackedByteArray stored = compressed ? bytes.compress(_compression_mode(database_compression)) : bytes;
+        file->store_32(id);
+        file->store_32(compressed ? database_compression : 0);
+        file->store_64(bytes.size());
+        file->store_64(stored.size());
+        _pad_to_alignment(file);
+        file->store_buffer(stored);
+        _pad_to_alignment(file);
+    }
+
+    static bool _load_block(const Ref<FileAccess>& file, DatabaseBlock expected_id, PackedByteArray& bytes)
+    {
+        const uint32_t id = file->get_32();
+        const uint32_t compression = file->get_32();
+        const int64_t raw_size = file->get_64();
+        const int64_t stored_size = file->get_64();
+        ERR_FAIL_COND_V_MSG(id != expected_id, false, "Unexpected block in the motion database");
+        _skip_to_alignment(file);
+        const PackedByteArray stored = file->get_buffer(stored_size);
+        ERR_FAIL_COND_V_MSG(stored.size() != stored_size, false, "Truncated block in the motion database");
+        bytes = compression == 0 ? stored : stored.decompress(raw_size, _compression_mode(compression));
+        ERR_FAIL_COND_V_MSG(bytes.size() != raw_size, false, "Corrupted block in the motion database");
+        _skip_to_alignment(file);
+        return true;
+    }
+
+    static FileAccess::CompressionMode _compression_mode(int compression)
+    {
+        return compression == 2 ? FileAccess::COMPRESSION_DEFLATE : FileAccess::COMPRESSION_ZSTD;
+    }
+
+    Error save_database()
+    {
+        ERR_FAIL_COND_V_EDMSG(database_path.is_empty(), ERR_FILE_BAD_PATH, "No database_path to save the motion database");
+        Ref<FileAccess> file = FileAccess::open(database_path, FileAccess::WRITE);
+        ERR_FAIL_COND_V_EDMSG(file.is_null(), FileAccess::get_open_error(), "Can't open " + database_path);
+        file->set_big_endian(false);
+        file->store_32(database_magic);
+        file->store_32(database_version);
+        file->store_32(nb_dimensions);
+        file->store_32(BLOCK_COUNT);
+        file->store_64(db_anim_index.size());
+        _pad_to_alignment(file);
+
+        _store_block(file, BLOCK_MOTION_DATA, MotionData.to_byte_array());
+        _store_block(file, BLOCK_MEANS, means.to_byte_array());
+        _store_block(file, BLOCK_VARIANCES, variances.to_byte_array());
+        _store_block(file, BLOCK_DENSITIES, u::var_to_bytes(densities));
+        _store_block(file, BLOCK_ANIM_INDEX, db_anim_index.to_byte_array());
+        _store_block(file, BLOCK_ANIM_TIMESTAMP, db_anim_timestamp.to_byte_array());
+        _store_block(file, BLOCK_ANIM_CATEGORY, db_anim_category.to_byte_array());
+        _store_block(file, BLOCK_ANIM_BIAS, db_anim_bias.to_byte_array());
+        u::prints("Motion database saved to", database_path, "Size", file->get_position());
+        return OK;
+    }
+
+    Error load_database()
+    {
+        ERR_FAIL_COND_V_EDMSG(database_path.is_empty(), ERR_FILE_BAD_PATH, "No database_path to load the motion database");
+        Ref<FileAccess> file = FileAccess::open(database_path, FileAccess::READ);
+        ERR_FAIL_COND_V_EDMSG(file.is_null(), FileAccess::get_open_error(), "Can't open " + database_path);
+        file->set_big_endian(false);
+        ERR_FAIL_COND_V_EDMSG(file->get_32() != database_magic, ERR_FILE_UNRECOGNIZED, database_path + " is not a motion database");
+        const uint32_t version = file->get_32();
+        ERR_FAIL_COND_V_EDMSG(version < 1 || version > database_version, ERR_FILE_UNRECOGNIZED, database_path + " has an unsupported version");
+        const int32_t file_dimensions = file->get_32();
+        const uint32_t block_count = version == 1 ? BLOCK_ANIM_BIAS : BLOCK_COUNT;
+        ERR_FAIL_COND_V_EDMSG(file->get_32() != block_count, ERR_FILE_CORRUPT, database_path + " has an unexpected block count");
+        const int64_t row_count = file->get_64();
+        _skip_to_alignment(file);
+
+        PackedByteArray blocks[BLOCK_COUNT];
+        for (uint32_t block = 0; block < block_count; ++block)
+        {
+            ERR_FAIL_COND_V_EDMSG(!_load_block(file, DatabaseBlock(block), blocks[block]), ERR_FILE_CORRUPT, "Failed to read " + database_path);
+        }
+        const PackedFloat32Array data = blocks[BLOCK_MOTION_DATA].to_float32_array();
+        const PackedInt32Array anim_index = blocks[BLOCK_ANIM_INDEX].to_int32_array();
+        ERR_FAIL_COND_V_EDMSG(data.size() != row_count * file_dimensions || anim_index.size() != row_count, ERR_FILE_CORRUPT, database_path + " has inconsistent sizes");
+
+        nb_dimensions = file_dimensions;
+        MotionData = data;
+        means = blocks[BLOCK_MEANS].to_float32_array();
+        variances = blocks[BLOCK_VARIANCES].to_float32_array();
+        densities = u::bytes_to_var(blocks[BLOCK_DENSITIES]);
+        db_anim_index = anim_index;
+        db_anim_timestamp = blocks[BLOCK_ANIM_TIMESTAMP].to_float32_array();
+        db_anim_category = blocks[BLOCK_ANIM_CATEGORY].to_int32_array();
+        db_anim_bias = blocks[BLOCK_ANIM_BIAS].to_float32_array();
+        invalidate_index();
+        return OK;
+    }
+
+    // With a database file, the baked arrays are not stored in the resource anymore.
+    void _validate_property(PropertyInfo& property) const
+    {
+        static const StringName database_properties[] = {"MotionData", "means", "variances", "densities", "db_anim_index", "db_anim_timestamp", "db_anim_category", "db_anim_bias"};
+        // Until the file is written, the resource keeps the arrays.
+        if (database_path.is_empty() || !FileAccess::file_exists(database_path))
+        {
+            return;
+        }
+        for (const StringName& name : database_properties)
+        {
+            if (property.name == name)
+            {
+                property.usage &= ~PROPERTY_USAGE_STORAGE;
+            }
+        }
+    }
+
+    // Calculate the weights using the features get_weights() functions.
+    // Take into consideration the number of dimensions.
+    // The calculation might be reconsidered, but it's the best I found.
+    void recalculate_weights()
+    {
+        weights.clear();
+
+        for (auto features_index = 0; features_index < motion_features.size(); ++features_index)
+        {   
+            MotionFeature *f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            
+            weights.append_array(f->get_weights() );
+            u::prints(f->get_name(),f->get_weights());
+        }
+        u::prints("New Weights Values:",weights);
+        _rebuild_index_in_background();
+    }
+
+    // Bypass the feature query, and ask directly which poses is the most similar.
+    // The query must be of the correct dimension.
+    Array check_query_results(PackedFloat32Array query,int64_t nb_result = 1)
+    {
+        ERR_FAIL_COND_V_MSG(query.size() != nb_dimensions, {}, "Query must the same size as nb_dimensions");
+        u::prints("query Constructed");
+
+        std::vector<int64_t> rows{};
+        _search(query.ptr(), nb_result, rows, nullptr, true);
+        u::prints("Results obtained");
+        Array result;
+        for(const int64_t row : rows)
+        {
+            const auto anim_name = get_row_animation_name(row);
+            const auto anim_time = db_anim_timestamp[row];
+            const auto anim_cat = db_anim_category[row];
+            result.append(Array::make(anim_name,anim_time,anim_cat));
+        }
+        return result;
+    }
+
+    // Rows [first, end[ of each animation, by db_anim_index, built on demand and cleared when the rows move.
+    // The rows of an animation are contiguous after bake_data. When an animation is appended again,
+    // its range also covers the removed rows and the rows in between, the scan skips them.
+    std::vector<std::pair<int64_t, int64_t>> animation_row_ranges{};
+
+    std::pair<int64_t, int64_t> _animation_row_range(int64_t anim_index)
+    {
+        if (animation_row_ranges.empty())
+        {
+            const int64_t row_count = db_anim_index.size();
+            for (int64_t row = 0; row < row_count; ++row)
+            {
+                const int32_t anim = db_anim_index[row];
+                if (anim < 0)
                 {
-                    MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
-                    PackedFloat32Array feature_data = f->bake_animation_pose(animation,time);
-                    ERR_FAIL_COND_MSG(feature_data.size() != f->get_dimension(),String("Features no.") + u::str(int(features_index))+"bake_animation_pose didn't return a array of the correct size:");
-                    pose_data.append_array(feature_data);                    
+                    continue;
                 }
-
-                
-                for(int i = 0; i<nb_dimensions;++i)
+                if (anim >= (int64_t)animation_row_ranges.size())
                 {
-                    data_stats[i](pose_data[i]);
+                    animation_row_ranges.resize(anim + 1, {row_count, 0});
                 }
-                data.append_array(pose_data);
-                db_anim_index.append(anim_index);
-                db_anim_timestamp.append(time);
-                db_anim_category.append(tmp_category_value);
+                auto& range = animation_row_ranges[anim];
+                range.first = std::min(range.first, row);
+                range.second = row + 1;
+            }
+        }
+        return anim_index < (int64_t)animation_row_ranges.size() ? animation_row_ranges[anim_index] : std::pair<int64_t, int64_t>{0, 0};
+    }
 
-                ++counter;
+    // Best entry pose in one animation : a linear scan of its rows only, without the index.
+    // Returns animation, timestamp and cost, empty if the animation has no usable row.
+    Dictionary find_best_entry(StringName animation_name, PackedFloat32Array query)
+    {
+        ERR_FAIL_COND_V_MSG(query.size() != nb_dimensions, {}, "Query must the same size as nb_dimensions");
+        const int64_t anim_index = baked_animation_names.is_empty() ? Array(get_animation_list()).find(animation_name) : baked_animation_names.find(animation_name);
+        ERR_FAIL_COND_V_EDMSG(anim_index == -1, {}, "Animation '" + String(animation_name) + "' isn't baked");
+        const auto [first_row, end_row] = _animation_row_range(anim_index);
+
+        const float* q = query.ptr();
+        const float* data = MotionData.ptr();
+        const int32_t* rows_anim = db_anim_index.ptr();
+        const int32_t* categories = db_anim_category.ptr();
+        // The same cost as the search : the bias of _row_biases(), without computing it for the other animations.
+        const float* biases = db_anim_bias.size() == db_anim_index.size() ? db_anim_bias.ptr() : nullptr;
+        const float animation_bias = animation_biases.get(animation_name, 0.0f);
+        int64_t best_row = -1;
+        float best_cost = std::numeric_limits<float>::max();
+        for (int64_t row = first_row; row < end_row; ++row)
+        {
+            if (rows_anim[row] != anim_index || (categories[row] & MMDatabaseIndex::removed_category_bit))
+            {
+                continue;
             }
-            auto clock_end = std::chrono::system_clock::now();
-            float duration = float(std::chrono::duration_cast <std::chrono::milliseconds> (clock_end - clock_start).count());
-            u::prints("Collecting animation data from ",animation->get_name(), " in ", duration, "ms. PoseCount",counter);
+            const float cost = _pose_distance(q, data + row * nb_dimensions) + (biases != nullptr ? biases[row] : 0.0f) + animation_bias;
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_row = row;
+            }
+        }
+        Dictionary result{};
+        if (best_row != -1)
+        {
+            result["animation"] = animation_name;
+            result["timestamp"] = refine_timestamp ? _refine_timestamp(q, best_row) : db_anim_timestamp[best_row];
+            result["cost"] = best_cost;
+        }
+        return result;
+    }
+
+    // Bake an animation added to the library after the last bake_data, and add its rows to the index
+    // without rebuilding it : the rows go in a new segment, merged in the background once there are more than
+    // max_index_segments. An animation already baked is replaced. means, variances and densities are only
+    // updated by bake_data. The database file is only saved in the editor (res:// is read-only in exported projects),
+    // at runtime call save_database() to write it somewhere else.
+    bool append_animation_rows(StringName animation_name)
+    {
+        ERR_FAIL_COND_V_EDMSG(!has_animation(animation_name), false, "No animation '" + String(animation_name) + "' in the library");
+        ERR_FAIL_COND_V_EDMSG(nb_dimensions == 0 || MotionData.size() != db_anim_index.size() * nb_dimensions, false, "bake_data must be called before appending animations");
+        int dimensions = 0;
+        if (!_setup_features(dimensions))
+        {
+            return false;
+        }
+        ERR_FAIL_COND_V_EDMSG(dimensions != nb_dimensions || (int64_t)_hash_configuration() != baked_configuration_hash, false, "The features changed since the last bake, bake_data must be called");
+
+        if (baked_animation_names.has(animation_name))
+        {
+            _remove_animation_rows(animation_name);
+        }
+        const int64_t existing_index = baked_animation_names.find(animation_name);
+        const int32_t anim_index = existing_index != -1 ? existing_index : baked_animation_names.size();
+        const Ref<Animation> animation = get_animation(animation_name);
+        const int64_t first_row = db_anim_index.size();
+
+        _set_features_sampler(&skeleton_sampler);
+        const int64_t row_count = _bake_animation(anim_index, animation, MotionData);
+        _set_features_sampler(nullptr);
+        if (row_count < 0)
+        {
+            MotionData.resize(first_row * nb_dimensions);
+            ERR_FAIL_V_EDMSG(false, "Baking failed for animation '" + String(animation_name) + "'");
+        }
+        baked_animation_hashes[animation_name] = (int64_t)_hash_animation(animation);
+        baked_animation_names = baked_animation_hashes.keys();
+        _invalidate_animation_table();
+        animation_row_ranges.clear();
+
+        const bool was_current = _is_index_current();
+        ++index_generation;
+        const auto current_index = get_index_snapshot();
+        if (current_index != nullptr)
+        {
+            const PackedFloat32Array biases = _row_biases();
+            std::atomic_store(&index, current_index->with_appended_rows(MotionData.ptr() + first_row * nb_dimensions, db_anim_category.ptr() + first_row, biases.is_empty() ? nullptr : biases.ptr() + first_row, row_count, first_row));
+            if (was_current)
+            {
+                published_generation = index_generation;
+            }
+            if (async_index_build && current_index->get_segment_count() >= max_index_segments)
+            {
+                _rebuild_index_in_background();
+            }
+        }
+        _save_database_in_editor();
+        u::prints("Appended animation", animation_name, "PoseCount", row_count);
+        return true;
+    }
+
+    // Flag the rows of an animation as removed. The queries skip them right away.
+    // The rows stay in MotionData and the db_anim_* arrays, so the row numbers already returned keep their meaning,
+    // until compact_database() or bake_data() drop them. Like append_animation_rows, only saves the database file in the editor.
+    void remove_animation_rows(StringName animation_name)
+    {
+        if (_remove_animation_rows(animation_name))
+        {
+            _save_database_in_editor();
+        }
+    }
+
+    // baked_animation_hashes is saved with the resource, the rows must be in the .mmdb to match it.
+    void _save_database_in_editor()
+    {
+        if (!database_path.is_empty() && Engine::get_singleton()->is_editor_hint())
+        {
+            save_database();
         }
+    }
 
-        u::prints("Animation Data Collected. Normalizing... ");
+    bool _remove_animation_rows(StringName animation_name)
+    {
+        const int64_t anim_index = baked_animation_names.find(animation_name);
+        ERR_FAIL_COND_V_EDMSG(anim_index == -1, false, "Animation '" + String(animation_name) + "' isn't baked");
+        const int64_t row_count = db_anim_index.size();
+        const int32_t* rows_anim = db_anim_index.ptr();
+        int32_t* categories = db_anim_category.ptrw();
+        auto removed = std::make_shared<std::vector<bool>>(row_count, false);
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            if (rows_anim[row] == anim_index)
+            {
+                categories[row] |= MMDatabaseIndex::removed_category_bit;
+            }
+            (*removed)[row] = (categories[row] & MMDatabaseIndex::removed_category_bit) != 0;
+        }
+        // The animation keeps its position, its rows will never be reused by bake_data.
+        baked_animation_hashes[animation_name] = 0;
 
-        for(auto i = 0; i< nb_dimensions;++i)
+        const bool was_current = _is_index_current();
+        ++index_generation;
+        const auto current_index = get_index_snapshot();
+        if (current_index != nullptr)
         {
-            means[i] = mean(data_stats[i]);
-            variances[i] = variance(data_stats[i]);
-            if (variances[i] <= std::numeric_limits<float>::epsilon() )
+            std::atomic_store(&index, current_index->with_removed_rows(removed));
+            if (was_current)
             {
-                variances[i] = 1.0f;
+                published_generation = index_generation;
             }
-            Array arr{};
-            for(const auto& d : density(data_stats[i]))
+            // The removed rows are only skipped, a rebuild wouldn't drop them : merge the segments like append does.
+            if (async_index_build && current_index->get_segment_count() >= max_index_segments)
             {
-                arr.append(Array::make(d.first,d.second) ); 
+                _rebuild_index_in_background();
             }
-            densities[i] = std::move(arr);
         }
-        
-        // // Normalization
-        // for(size_t pose = 0; pose < data.size()/nb_dimensions; ++pose)
-        // {
-        //     for(int offset = 0; offset<nb_dimensions;++offset)
-        //     {
-        //         data[pose*nb_dimensions + offset] = (data[pose*nb_dimensions + offset] - means[offset])/variances[offset]; 
-        //     }
-        // }
-
-        u::prints("Data Normalized. Copy data to Motion Data property...");
-        MotionData = data.duplicate();
+        return true;
+    }
 
-        if(weights.size() != nb_dimensions)
+    // Keep only the rows flagged in keep, in MotionData and the db_anim_* arrays.
+    void _keep_rows(const std::vector<bool>& keep)
+    {
+        const int64_t row_count = db_anim_index.size();
+        ERR_FAIL_COND((int64_t)keep.size() != row_count);
+        float* data = MotionData.ptrw();
+        int32_t* index = db_anim_index.ptrw();
+        float* timestamp = db_anim_timestamp.ptrw();
+        int32_t* category = db_anim_category.ptrw();
+        float* bias = db_anim_bias.size() == row_count ? db_anim_bias.ptrw() : nullptr;
+        int64_t kept = 0;
+        for (int64_t row = 0; row < row_count; ++row)
         {
-            WARN_PRINT_ED("Weights resized to " + u::str(nb_dimensions)+ " and reset to ones.");
-            weights.resize(nb_dimensions);
-            weights.fill(1.0);
+            if (!keep[row])
+            {
+                continue;
+            }
+            if (kept != row)
+            {
+                std::copy_n(data + row * nb_dimensions, nb_dimensions, data + kept * nb_dimensions);
+                index[kept] = index[row];
+                timestamp[kept] = timestamp[row];
+                category[kept] = category[row];
+                if (bias != nullptr)
+                {
+                    bias[kept] = bias[row];
+                }
+            }
+            ++kept;
         }
-
-        u::prints("Finished All Animations");
-        u::prints("NbDim",nb_dimensions,"NbPoses:",data.size()/nb_dimensions,"Size",data.size());
+        MotionData.resize(kept * nb_dimensions);
+        db_anim_index.resize(kept);
+        db_anim_timestamp.resize(kept);
+        db_anim_category.resize(kept);
+        db_anim_bias.resize(bias != nullptr ? kept : 0);
+        invalidate_index();
     }
 
-    // Calculate the weights using the features get_weights() functions.
-    // Take into consideration the number of dimensions.
-    // The calculation might be reconsidered, but it's the best I found.
-    void recalculate_weights()
+    // Average time of a nearest neighbor query, in microseconds, using some rows of the database as queries.
+    float _benchmark_queries(int64_t query_count = 256)
     {
-        weights.clear();
-
-        for (auto features_index = 0; features_index < motion_features.size(); ++features_index)
-        {   
-            MotionFeature *f = Object::cast_to<MotionFeature>(motion_features[features_index]);
-            
-            weights.append_array(f->get_weights() );
-            u::prints(f->get_name(),f->get_weights());
+        const auto current_index = _get_index(true);
+        const int64_t row_count = db_anim_index.size();
+        if (current_index == nullptr || row_count == 0)
+        {
+            return 0.0f;
         }
-        u::prints("New Weights Values:",weights);
+        const int64_t step = std::max<int64_t>(1, row_count / query_count);
+        std::vector<int64_t> rows{};
+        int64_t count = 0;
+        auto clock_start = std::chrono::steady_clock::now();
+        for (int64_t row = 0; row < row_count; row += step, ++count)
+        {
+            current_index->k_nearest_rows(MotionData.ptr() + row * nb_dimensions, 1, rows);
+        }
+        auto clock_end = std::chrono::steady_clock::now();
+        return float(std::chrono::duration_cast<std::chrono::microseconds>(clock_end - clock_start).count()) / count;
     }
 
-    // Bypass the feature query, and ask directly which poses is the most similar.
-    // The query must be of the correct dimension.
-    Array check_query_results(PackedFloat32Array query,int64_t nb_result = 1)
+    // Remove the near-duplicate poses of the whole database, and the rows flagged by remove_animation_rows(). Rows are visited in order, each row kept is the
+    // representative of the rows of the same category and bias within epsilon (with the kdtree distance), which are removed.
+    // The animations keep their place, but the next bake_data re-bakes them all instead of reusing the compacted rows.
+    // Returns the rows, bytes and average query time before and after.
+    Dictionary compact_database(float epsilon)
     {
-        _cache_kdtree(true);
-
-        auto begin = weights.ptr(), end = weights.ptr(); // We use the ptr as iterator.
-        begin = std::next(begin,0);
-        end =   std::next(begin,query.size());
-        const std::vector<float> tmp_weight(begin,end);
-
-        kdt->set_distance(distance_type,&tmp_weight);
-
-        auto query_data = Kdtree::CoordPoint(query.ptr(),std::next(query.ptr(),query.size()));
+        ERR_FAIL_COND_V_EDMSG(epsilon < 0.0f, {}, "epsilon must be positive");
+        ERR_FAIL_COND_V_EDMSG(nb_dimensions == 0 || MotionData.size() != db_anim_index.size() * nb_dimensions, {}, "The library must be baked before being compacted");
+        const auto current_index = _get_index(true);
+        ERR_FAIL_NULL_V(current_index, {});
+
+        const int64_t row_count = db_anim_index.size();
+        const int64_t row_bytes = nb_dimensions * sizeof(float) + sizeof(int32_t) * 2 + sizeof(float);
+        Dictionary result{};
+        result["rows_before"] = row_count;
+        result["bytes_before"] = row_count * row_bytes;
+        result["query_usec_before"] = _benchmark_queries();
+
+        std::vector<bool> keep(row_count, true);
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            keep[row] = (db_anim_category[row] & MMDatabaseIndex::removed_category_bit) == 0;
+        }
+        const bool has_biases = db_anim_bias.size() == row_count;
+        std::vector<int64_t> neighbors{};
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            if (!keep[row])
+            {
+                continue;
+            }
+            current_index->range_rows(MotionData.ptr() + row * nb_dimensions, epsilon, neighbors);
+            for (const int64_t neighbor : neighbors)
+            {
+                // Only the rows after this one can be removed, the ones before are already representatives.
+                if (neighbor > row && db_anim_category[neighbor] == db_anim_category[row] && (!has_biases || db_anim_bias[neighbor] == db_anim_bias[row]))
+                {
+                    keep[neighbor] = false;
+                }
+            }
+        }
 
-        u::prints("query Constructed");
+        _keep_rows(keep);
+        _compute_statistics();
+        // A compacted animation misses the rows that were duplicates of another one, which may be re-baked later.
+        const Array compacted_names = baked_animation_hashes.keys();
+        for (int64_t i = 0; i < compacted_names.size(); ++i)
+        {
+            baked_animation_hashes[compacted_names[i]] = 0;
+        }
 
-        Kdtree::KdNodeVector re{};
-        kdt->k_nearest_neighbors(query_data,nb_result,&re);
-        u::prints("Results obtained");
-        Array result;
-        for(auto i : re)
+        result["rows_after"] = db_anim_index.size();
+        result["bytes_after"] = db_anim_index.size() * row_bytes;
+        result["query_usec_after"] = _benchmark_queries();
+        if (!database_path.is_empty())
         {
-            const auto anim_name = get_animation_list()[db_anim_index[i.index]];
-            const auto anim_time = db_anim_timestamp[i.index];
-            const auto anim_cat = db_anim_category[i.index];
-            result.append(Array::make(anim_name,anim_time,anim_cat));
+            save_database();
         }
+        u::prints("Compacted database from", result["rows_before"], "to", result["rows_after"], "rows.");
         return result;
     }
 
@@ -417,12 +1690,25 @@ struct MMAnimationLibrary : public AnimationLibrary {
 
 
 
-    Dictionary query_pose(PackedFloat32Array query,int64_t included_category = std::numeric_limits<int64_t>::max(), int64_t excluded_category = 0)
+    // Negative weights would break the lower bounds the kdtree prunes with.
+    bool _check_weights_override(const PackedFloat32Array& weights_override, const String& name = "weights_override") const
+    {
+        ERR_FAIL_COND_V_MSG(!weights_override.is_empty() && weights_override.size() != nb_dimensions, false, name + " must be empty or the same size as nb_dimensions");
+        for (const float weight : weights_override)
+        {
+            ERR_FAIL_COND_V_MSG(weight < 0.0f, false, name + " can't be negative");
+        }
+        return true;
+    }
+
+    // weights_override, when not empty, replaces the weights for this query only (trajectory heavy while sprinting...).
+    // It's read in place by the search, the index doesn't need to be rebuilt.
+    // lod picks the database searched, see lod_row_steps.
+    Dictionary query_pose(PackedFloat32Array query,int64_t included_category = std::numeric_limits<int64_t>::max(), int64_t excluded_category = 0, PackedFloat32Array weights_override = {}, int lod = 0)
     {
         
         ERR_FAIL_COND_V_MSG(query.size() != nb_dimensions, {}, "Query must the same size as nb_dimensions");
-        // Create three if needs be
-        _cache_kdtree();
+        ERR_FAIL_COND_V(!_check_weights_override(weights_override), {});
 
         // Normalization
         // for (size_t i = 0; i < means.size();++i)
@@ -430,38 +1716,530 @@ struct MMAnimationLibrary : public AnimationLibrary {
         //     query[i] = (query[i] - means[i])/variances[i]; 
         // }
 
+        return _query_pose(query.ptr(), included_category, excluded_category, weights_override.is_empty() ? nullptr : weights_override.ptr(), lod);
+    }
+
+    // query_pose on a subspace of the features, with the same index : the dimensions where dimension_mask is 0
+    // are ignored by the distance and the pruning. Other values of the mask scale the weights.
+    // The query has either nb_dimensions values (the masked ones are ignored), or one value per unmasked dimension.
+    Dictionary query_pose_masked(PackedFloat32Array query, PackedFloat32Array dimension_mask, int64_t included_category = std::numeric_limits<int64_t>::max(), int64_t excluded_category = 0)
+    {
+        ERR_FAIL_COND_V_MSG(dimension_mask.size() != nb_dimensions, {}, "dimension_mask must the same size as nb_dimensions");
+        ERR_FAIL_COND_V(!_check_weights_override(dimension_mask, "dimension_mask"), {});
+        const std::vector<float> mask(dimension_mask.ptr(), dimension_mask.ptr() + nb_dimensions);
+        std::vector<float> masked_weights(nb_dimensions);
+        for (int32_t i = 0; i < nb_dimensions; ++i)
+        {
+            masked_weights[i] = _weight(i) * mask[i];
+        }
+        const int64_t unmasked_count = std::count_if(mask.begin(), mask.end(), [](float factor){ return factor != 0.0f; });
+        PackedFloat32Array full_query = query;
+        if (query.size() == unmasked_count && unmasked_count != nb_dimensions)
         {
-            Kdtree::KdNodeVector re{};
+            full_query.resize(nb_dimensions);
+            int64_t unmasked = 0;
+            for (int64_t i = 0; i < nb_dimensions; ++i)
+            {
+                full_query.set(i, mask[i] != 0.0f ? query[unmasked++] : 0.0f);
+            }
+        }
+        ERR_FAIL_COND_V_MSG(full_query.size() != nb_dimensions, {}, "Query must have nb_dimensions values, or one per unmasked dimension");
+        return _query_pose(full_query.ptr(), included_category, excluded_category, masked_weights.data());
+    }
 
-            auto query_data = Kdtree::CoordPoint(query.ptr(),std::next(query.ptr(),kdt->dimension));
-            auto clock_start = std::chrono::system_clock::now();
-            if(included_category == std::numeric_limits<int64_t>::max())
-                kdt->k_nearest_neighbors(query_data,1,&re);
-            else
+    // Dimension mask for query_pose_masked, enabling only the features of motion_features at enabled_features.
+    PackedFloat32Array get_features_mask(PackedInt32Array enabled_features)
+    {
+        PackedFloat32Array mask{};
+        for (int32_t features_index = 0; features_index < motion_features.size(); ++features_index)
+        {
+            MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            ERR_FAIL_NULL_V(f, {});
+            const float factor = enabled_features.has(features_index) ? 1.0f : 0.0f;
+            for (int i = 0; i < f->get_dimension(); ++i)
             {
-                auto pred = Category_Pred(included_category,excluded_category);
-                kdt->k_nearest_neighbors(query_data,1,&re,&pred);
+                mask.push_back(factor);
             }
+        }
+        ERR_FAIL_COND_V_MSG(mask.size() != nb_dimensions, {}, "The features changed since the last bake");
+        return mask;
+    }
 
-            auto clock_end = std::chrono::system_clock::now();
-            
-            float duration = float(std::chrono::duration_cast <std::chrono::microseconds> (clock_end - clock_start).count());
+    // Rows baked one after the other from the same part of an animation : same animation and category,
+    // and no gap in the sampling (rows skipped by their category, or dropped by the adaptive sampling).
+    bool _is_next_row(int64_t row, int64_t neighbor) const
+    {
+        if (neighbor < 0 || neighbor >= db_anim_index.size() || db_anim_index[neighbor] != db_anim_index[row] || db_anim_category[neighbor] != db_anim_category[row])
+        {
+            return false;
+        }
+        const float max_gap = adaptive_sampling ? adaptive_max_gap : 1.5f * time_interval;
+        return std::abs(db_anim_timestamp[neighbor] - db_anim_timestamp[row]) <= max_gap;
+    }
+
+    // Timestamp around row minimizing the distance to the query, see refine_timestamp.
+    // Along a segment between two rows the distance is convex, a golden section search finds its minimum.
+    float _refine_timestamp(const float* query, int64_t row, const float* custom_weights = nullptr) const
+    {
+        const float* row_pose = MotionData.ptr() + row * nb_dimensions;
+        std::vector<float> pose(nb_dimensions);
+        float best_time = db_anim_timestamp[row];
+        float best_cost = _pose_distance(query, row_pose, custom_weights);
+        for (const int64_t neighbor : {row - 1, row + 1})
+        {
+            if (!_is_next_row(row, neighbor))
+            {
+                continue;
+            }
+            const float* neighbor_pose = MotionData.ptr() + neighbor * nb_dimensions;
+            const auto cost_at = [&](float alpha)
+            {
+                for (int i = 0; i < nb_dimensions; ++i)
+                {
+                    pose[i] = Math::lerp(row_pose[i], neighbor_pose[i], alpha);
+                }
+                return _pose_distance(query, pose.data(), custom_weights);
+            };
+            constexpr float ratio = 0.61803398875f;
+            float low = 0.0f, high = 1.0f;
+            float alpha_1 = high - ratio * (high - low), alpha_2 = low + ratio * (high - low);
+            float cost_1 = cost_at(alpha_1), cost_2 = cost_at(alpha_2);
+            for (int iteration = 0; iteration < refine_iterations; ++iteration)
+            {
+                if (cost_1 < cost_2)
+                {
+                    high = alpha_2; alpha_2 = alpha_1; cost_2 = cost_1;
+                    alpha_1 = high - ratio * (high - low); cost_1 = cost_at(alpha_1);
+                }
+                else
+                {
+                    low = alpha_1; alpha_1 = alpha_2; cost_1 = cost_2;
+                    alpha_2 = low + ratio * (high - low); cost_2 = cost_at(alpha_2);
+                }
+            }
+            const float alpha = 0.5f * (low + high);
+            const float cost = cost_at(alpha);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_time = Math::lerp(db_anim_timestamp[row], db_anim_timestamp[neighbor], alpha);
+            }
+        }
+        return best_time;
+    }
+
+    // Bone of the skeleton_profile on the other side for each bone, the bone itself when it has no side.
+    PackedInt32Array get_mirror_bones()
+    {
+        PackedInt32Array result{};
+        ERR_FAIL_COND_V(skeleton_profile == nullptr, result);
+        for (int32_t bone = 0; bone < skeleton_profile->get_bone_size(); ++bone)
+        {
+            const int32_t mirror = skeleton_profile->find_bone(MotionFeature::mirror_bone_name(skeleton_profile->get_bone_name(bone)));
+            result.push_back(mirror != -1 ? mirror : bone);
+        }
+        return result;
+    }
+
+    bool _setup_mirror()
+    {
+        if ((int64_t)mirror_permutation.size() == nb_dimensions)
+        {
+            return true;
+        }
+        int dimensions = 0;
+        if (!_setup_features(dimensions))
+        {
+            return false;
+        }
+        ERR_FAIL_COND_V_MSG(dimensions != nb_dimensions, false, "The features changed since the last bake");
+        const PackedInt32Array mirror_bones = get_mirror_bones();
+        std::vector<int32_t> permutation(nb_dimensions);
+        std::vector<float> signs(nb_dimensions);
+        int32_t offset = 0;
+        for (int64_t features_index = 0; features_index < motion_features.size(); ++features_index)
+        {
+            MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            const int dimension = f->get_dimension();
+            ERR_FAIL_COND_V_MSG(offset + dimension > nb_dimensions, false, "The features changed since the last bake");
+            f->get_mirror_mapping(mirror_bones, permutation.data() + offset, signs.data() + offset);
+            for (int i = offset; i < offset + dimension; ++i)
+            {
+                permutation[i] += offset;
+            }
+            offset += dimension;
+        }
+        ERR_FAIL_COND_V_MSG(offset != nb_dimensions, false, "The features changed since the last bake");
+        if (weights.size() == nb_dimensions)
+        {
+            for (int32_t i = 0; i < nb_dimensions; ++i)
+            {
+                if (weights[i] != weights[permutation[i]])
+                {
+                    WARN_PRINT_ED("The weights of the two sides are different, the mirrored costs won't match the mirrored poses");
+                    break;
+                }
+            }
+        }
+        mirror_permutation = std::move(permutation);
+        mirror_signs = std::move(signs);
+        return true;
+    }
+
+    // Pose with left and right swapped, see mirror_search.
+    PackedFloat32Array mirror_pose(PackedFloat32Array pose)
+    {
+        ERR_FAIL_COND_V_MSG(pose.size() != nb_dimensions, {}, "Pose must the same size as nb_dimensions");
+        ERR_FAIL_COND_V(!_setup_mirror(), {});
+        PackedFloat32Array result{};
+        result.resize(nb_dimensions);
+        for (int32_t i = 0; i < nb_dimensions; ++i)
+        {
+            result.set(i, mirror_signs[i] * pose[mirror_permutation[i]]);
+        }
+        return result;
+    }
+
+    bool _setup_rate_exponents()
+    {
+        if ((int64_t)rate_exponents.size() == nb_dimensions)
+        {
+            return true;
+        }
+        int dimensions = 0;
+        if (!_setup_features(dimensions))
+        {
+            return false;
+        }
+        ERR_FAIL_COND_V_MSG(dimensions != nb_dimensions, false, "The features changed since the last bake");
+        std::vector<float> exponents(nb_dimensions);
+        int32_t offset = 0;
+        for (int64_t features_index = 0; features_index < motion_features.size(); ++features_index)
+        {
+            MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            const int dimension = f->get_dimension();
+            ERR_FAIL_COND_V_MSG(offset + dimension > nb_dimensions, false, "The features changed since the last bake");
+            f->get_rate_exponents(exponents.data() + offset);
+            offset += dimension;
+        }
+        ERR_FAIL_COND_V_MSG(offset != nb_dimensions, false, "The features changed since the last bake");
+        rate_exponents = std::move(exponents);
+        return true;
+    }
 
+    struct PoseMatch
+    {
+        int64_t row = -1;
+        float timestamp = 0.0f;
+        float cost = 0.0f;
+        bool mirrored = false;
+        float rate = 1.0f;
+    };
+
+    // Selects the rows of the LOD and builds its index, on a worker thread.
+    static void _build_lod_task(void* lod_build)
+    {
+        LodBuild& build = *static_cast<LodBuild*>(lod_build);
+        LodDatabase& database = *build.result;
+        // One row out of step, counted from the start of each run of rows of the same animation.
+        const int64_t row_count = build.anim_index.size();
+        int64_t run_start = 0;
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            if (row > 0 && build.anim_index[row] != build.anim_index[row - 1])
+            {
+                run_start = row;
+            }
+            if ((row - run_start) % build.step == 0 && !(build.categories[row] & MMDatabaseIndex::removed_category_bit))
+            {
+                database.rows.push_back(row);
+            }
+        }
+        ERR_FAIL_COND_MSG(database.rows.empty(), "The database is empty");
+
+        const int32_t lod_dimensions = database.dimensions.size();
+        const PackedFloat32Array row_biases = _combine_biases(build.anim_index, build.row_biases, build.animation_biases);
+        PackedFloat32Array data{}, biases{};
+        PackedInt32Array categories{};
+        data.resize(database.rows.size() * lod_dimensions);
+        categories.resize(database.rows.size());
+        biases.resize(row_biases.is_empty() ? 0 : database.rows.size());
+        float* write = data.ptrw();
+        for (size_t i = 0; i < database.rows.size(); ++i)
+        {
+            const int64_t row = database.rows[i];
+            const float* pose = build.data.ptr() + row * build.nb_dimensions;
+            for (const int32_t dimension : database.dimensions)
+            {
+                *write++ = pose[dimension];
+            }
+            categories.set(i, build.categories[row]);
+            if (!row_biases.is_empty())
+            {
+                biases.set(i, row_biases[row]);
+            }
+        }
+        database.index = MMDatabaseRegistry::acquire(data, categories, lod_dimensions, build.distance_type, build.weights, biases);
+    }
 
+    // Starts the task building the LOD for the current generation. Returns false if the LOD can't be built.
+    bool _start_lod_build(int lod, LodSlot& slot)
+    {
+        slot.started_generation = index_generation;
+        auto database = std::make_shared<LodDatabase>();
+        const PackedInt32Array enabled_features = lod - 1 < lod_features.size() ? PackedInt32Array(lod_features[lod - 1]) : PackedInt32Array();
+        int32_t offset = 0;
+        for (int32_t features_index = 0; features_index < motion_features.size(); ++features_index)
+        {
+            MotionFeature* f = Object::cast_to<MotionFeature>(motion_features[features_index]);
+            ERR_FAIL_NULL_V(f, false);
+            const bool enabled = enabled_features.is_empty() || enabled_features.has(features_index);
+            for (int i = 0; i < f->get_dimension(); ++i, ++offset)
+            {
+                if (enabled)
+                {
+                    database->dimensions.push_back(offset);
+                }
+            }
+        }
+        ERR_FAIL_COND_V_MSG(offset != nb_dimensions, false, "The features changed since the last bake");
+        ERR_FAIL_COND_V_MSG(database->dimensions.empty(), false, "LOD " + u::str(lod) + " has no dimension");
+        ERR_FAIL_COND_V_MSG(MotionData.size() != db_anim_index.size() * nb_dimensions || db_anim_category.size() != db_anim_index.size(), false, "The library must be baked before querying a LOD");
+
+        slot.build = std::make_unique<LodBuild>();
+        LodBuild& build = *slot.build;
+        build.data = MotionData;
+        build.anim_index = db_anim_index;
+        build.categories = db_anim_category;
+        build.row_biases = db_anim_bias;
+        build.animation_biases = _animation_bias_table();
+        for (const int32_t dimension : database->dimensions)
+        {
+            build.weights.push_back(_weight(dimension));
+        }
+        build.nb_dimensions = nb_dimensions;
+        build.distance_type = distance_type;
+        build.step = std::max(1, lod_row_steps[lod - 1]);
+        build.result = database;
+        slot.task_id = WorkerThreadPool::get_singleton()->add_native_task(&MMAnimationLibrary::_build_lod_task, &build, false, "MMAnimationLibrary LOD");
+        return true;
+    }
 
+    // Published database of the LOD, nullptr until its first index is ready.
+    // Starts a build when the LOD is out of date, and waits for it if asked.
+    std::shared_ptr<const LodDatabase> _get_lod(int lod, bool wait = false)
+    {
+        ERR_FAIL_COND_V_MSG(lod < 1 || lod > lod_row_steps.size(), nullptr, "LOD " + u::str(lod) + " isn't defined in lod_row_steps");
+        lod_slots.resize(lod_row_steps.size());
+        LodSlot& slot = lod_slots[lod - 1];
+        WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+        auto collect = [&](bool block)
+        {
+            if (slot.task_id == -1 || (!block && !pool->is_task_completed(slot.task_id)))
+            {
+                return;
+            }
+            pool->wait_for_task_completion(slot.task_id);
+            slot.task_id = -1;
+            if (slot.build->result->index != nullptr)
+            {
+                slot.database = slot.build->result;
+                u::prints("MMAL LOD", lod, "ready", (int64_t)slot.database->rows.size(), "poses", (int64_t)slot.database->dimensions.size(), "dimensions");
+            }
+            slot.build.reset();
+        };
+        collect(false);
+        if (slot.task_id == -1 && slot.started_generation != index_generation)
+        {
+            _start_lod_build(lod, slot);
+        }
+        collect(wait);
+        return slot.database;
+    }
 
-            Dictionary results = {};
+    // Number of rows of a LOD, waiting for its index if needed.
+    int64_t get_lod_row_count(int lod)
+    {
+        if (lod == 0)
+        {
+            return db_anim_index.size();
+        }
+        const auto database = _get_lod(lod, true);
+        return database != nullptr ? (int64_t)database->rows.size() : 0;
+    }
 
-            const StringName anim_name = get_animation_list()[db_anim_index[re[0].index]];
-            const float anim_time = db_anim_timestamp[re[0].index];
+    // Search in a LOD : the query keeps the layout of the full database, the dimensions the LOD drops are ignored.
+    // Mirrored and playback rate variants, and refine_timestamp, are only for the full database.
+    bool _match_pose_lod(const float* query, int lod, int64_t included_category, int64_t excluded_category, const float* custom_weights, PoseMatch& match)
+    {
+        ERR_FAIL_COND_V_MSG(lod < 1 || lod > lod_row_steps.size(), false, "LOD " + u::str(lod) + " isn't defined in lod_row_steps");
+        const auto database = _get_lod(lod);
+        if (database == nullptr)
+        {
+            // Not built yet, the frame doesn't wait for it.
+            return _match_pose(query, included_category, excluded_category, custom_weights, match);
+        }
+        const size_t lod_dimensions = database->dimensions.size();
+        std::vector<float> lod_query(lod_dimensions), lod_weights(custom_weights != nullptr ? lod_dimensions : 0);
+        for (size_t i = 0; i < lod_dimensions; ++i)
+        {
+            lod_query[i] = query[database->dimensions[i]];
+            if (custom_weights != nullptr)
+            {
+                lod_weights[i] = custom_weights[database->dimensions[i]];
+            }
+        }
+        const Category_Pred category_pred(included_category,excluded_category);
+        const Kdtree::KdNodePredicate* pred = included_category == std::numeric_limits<int64_t>::max() ? nullptr : &category_pred;
+        std::vector<int64_t> rows{};
+        std::vector<float> distances{};
+        database->index->k_nearest_rows(lod_query.data(), 1, rows, pred, &distances, custom_weights != nullptr ? lod_weights.data() : nullptr);
+        if (rows.empty())
+        {
+            return false;
+        }
+        match.row = database->rows[rows[0]];
+        ERR_FAIL_INDEX_V(match.row, db_anim_timestamp.size(), false);
+        match.timestamp = db_anim_timestamp[match.row];
+        match.cost = distances[0];
+        match.mirrored = false;
+        match.rate = 1.0f;
+        return true;
+    }
 
-            results["animation"] = anim_name;
-            results["timestamp"] = std::move(anim_time);
+    // Best pose for the query, false if none matches the categories.
+    // custom_weights, if any, replace the weights (nb_dimensions values, read in place).
+    bool _match_pose(const float* query, int64_t included_category, int64_t excluded_category, const float* custom_weights, PoseMatch& match)
+    {
+        const Category_Pred category_pred(included_category,excluded_category);
+        const Kdtree::KdNodePredicate* pred = included_category == std::numeric_limits<int64_t>::max() ? nullptr : &category_pred;
+        const auto search_index = _get_index();
+        const bool mirror = mirror_search && _setup_mirror();
+        const bool rates = !playback_rates.is_empty() && _setup_rate_exponents();
+
+        // The mirrored rows and the rows played at another rate are searched by transforming the query instead :
+        // the distance between the mirrored query and a row is the one between the query and the mirrored row,
+        // and a row scaled by s matches q with the weights scaled by s (s^2 for the squared distance) and the query q / s.
+        // A single index serves all the variants. Without variant, the query and the weights are searched as they are.
+        std::vector<float> variant_query{}, variant_weights{};
+        const auto make_variant = [&](bool mirrored, float rate)
+        {
+            bool weighted = custom_weights != nullptr;
+            variant_query.resize(nb_dimensions);
+            variant_weights.resize(nb_dimensions);
+            for (int32_t i = 0; i < nb_dimensions; ++i)
+            {
+                const int32_t source = mirrored ? mirror_permutation[i] : i;
+                float value = mirrored ? mirror_signs[i] * query[source] : query[source];
+                float weight = custom_weights != nullptr ? custom_weights[source] : _weight(source);
+                if (rate != 1.0f && rate_exponents[i] != 0.0f)
+                {
+                    const float scale = std::pow(rate, rate_exponents[i]);
+                    value /= scale;
+                    weight *= distance_type == 2 ? scale * scale : scale;
+                    weighted = true;
+                }
+                variant_query[i] = value;
+                variant_weights[i] = weight;
+            }
+            return weighted ? variant_weights.data() : nullptr;
+        };
+
+        bool best_mirrored = false;
+        float best_rate = 1.0f, best_cost = std::numeric_limits<float>::max();
+        int64_t best_row = -1;
+        std::vector<int64_t> rows{};
+        std::vector<float> distances{};
+        for (int side = 0; side < (mirror ? 2 : 1); ++side)
+        {
+            for (int64_t rate_index = 0; rate_index < (rates ? playback_rates.size() : 1); ++rate_index)
+            {
+                const bool mirrored = side == 1;
+                const float rate = rates ? playback_rates[rate_index] : 1.0f;
+                if (mirrored || rate != 1.0f)
+                {
+                    const float* weights_variant = make_variant(mirrored, rate);
+                    _search_with(search_index, variant_query.data(), 1, rows, pred, &distances, weights_variant);
+                }
+                else
+                {
+                    _search_with(search_index, query, 1, rows, pred, &distances, custom_weights);
+                }
+                if (!rows.empty() && distances[0] < best_cost)
+                {
+                    best_row = rows[0];
+                    best_cost = distances[0];
+                    best_mirrored = mirrored;
+                    best_rate = rate;
+                }
+            }
+        }
+        if (best_row == -1)
+        {
+            return false;
+        }
 
-            return results;
+        float anim_time = db_anim_timestamp[best_row];
+        if (refine_timestamp && (best_mirrored || best_rate != 1.0f))
+        {
+            const float* weights_variant = make_variant(best_mirrored, best_rate);
+            anim_time = _refine_timestamp(variant_query.data(), best_row, weights_variant);
+        }
+        else if (refine_timestamp)
+        {
+            anim_time = _refine_timestamp(query, best_row, custom_weights);
         }
-        return {};
 
+        match.row = best_row;
+        match.timestamp = anim_time;
+        match.cost = best_cost;
+        match.mirrored = best_mirrored;
+        match.rate = best_rate;
+        return true;
+    }
+
+    Dictionary _query_pose(const float* query, int64_t included_category, int64_t excluded_category, const float* custom_weights = nullptr, int lod = 0)
+    {
+        PoseMatch match{};
+        const bool found = lod == 0 ? _match_pose(query, included_category, excluded_category, custom_weights, match) : _match_pose_lod(query, lod, included_category, excluded_category, custom_weights, match);
+        ERR_FAIL_COND_V_MSG(!found, {}, "No pose matches the query categories");
+
+        Dictionary results = {};
+        results["animation"] = get_row_animation_name(match.row);
+        results["timestamp"] = match.timestamp;
+        results["cost"] = match.cost;
+        results["mirrored"] = match.mirrored;
+        results["rate"] = match.rate;
+        return results;
+    }
+
+    // query_pose writing into result instead of returning a Dictionary : when result is reused, no Variant container
+    // or string is created for the result. The search itself still allocates its small working buffers.
+    // Returns false, leaving result untouched, when no pose matches the categories.
+    bool query_pose_packed(PackedFloat32Array query, Ref<MMQueryResult> result, int64_t included_category = std::numeric_limits<int64_t>::max(), int64_t excluded_category = 0, PackedFloat32Array weights_override = {}, int lod = 0)
+    {
+        ERR_FAIL_COND_V(result.is_null(), false);
+        ERR_FAIL_COND_V_MSG(query.size() != nb_dimensions, false, "Query must the same size as nb_dimensions");
+        ERR_FAIL_COND_V(!_check_weights_override(weights_override), false);
+        PoseMatch match{};
+        const float* custom_weights = weights_override.is_empty() ? nullptr : weights_override.ptr();
+        const bool found = lod == 0 ? _match_pose(query.ptr(), included_category, excluded_category, custom_weights, match) : _match_pose_lod(query.ptr(), lod, included_category, excluded_category, custom_weights, match);
+        if (!found)
+        {
+            return false;
+        }
+        _build_animation_table();
+        const int32_t anim_index = db_anim_index[match.row];
+        const bool known = 0 <= anim_index && anim_index < (int64_t)animation_name_table.size();
+        result->animation_index = anim_index;
+        result->animation = known ? animation_name_table[anim_index] : StringName();
+        result->animation_resource = known ? animation_table[anim_index] : Ref<Animation>();
+        result->timestamp = match.timestamp;
+        result->row = match.row;
+        result->cost = match.cost;
+        result->mirrored = match.mirrored;
+        result->rate = match.rate;
+        return true;
     }
 
     enum Space
@@ -578,6 +2356,51 @@ struct MMAnimationLibrary : public AnimationLibrary {
         return result;
     }
 
+    // Every bone of the skeleton_profile at every time, in one pass : each bone is sampled once per time
+    // and composed from its parent, see SkeletonSampler. Spaces are the ones of the sample_bone_*_info methods.
+    // Returns positions, linear_vels and angular_vels (PackedVector3Array), rotations (PackedFloat32Array, x y z w)
+    // and bone_count. The arrays are laid out [time][bone], with the bones in the skeleton_profile order.
+    // space is a Space, taken as an int so the binding doesn't need the enum cast declared after the class.
+    Dictionary sample_skeleton(StringName animation_name, PackedFloat32Array times, int space = Local)
+    {
+        ERR_FAIL_COND_V(skeleton_profile == nullptr, {});
+        ERR_FAIL_COND_V(!has_animation(animation_name), {});
+        SkeletonSampler sampler{};
+        ERR_FAIL_COND_V(!sampler.setup_profile(NodePath(skeleton_path), skeleton_profile), {});
+        sampler.require_all_bones();
+        ERR_FAIL_COND_V(!sampler.setup_for_animation(get_animation(animation_name)), {});
+        const std::vector<double> sample_times(times.ptr(), times.ptr() + times.size());
+        sampler.evaluate(sample_times.data(), sample_times.size());
+
+        const kforms& poses = space == Model ? sampler.model : space == RootMotion ? sampler.rootmotion : space == Global ? sampler.global : sampler.local;
+        const int64_t count = poses.count();
+        PackedVector3Array positions{}, linear_vels{}, angular_vels{};
+        PackedFloat32Array rotations{};
+        positions.resize(count);
+        linear_vels.resize(count);
+        angular_vels.resize(count);
+        rotations.resize(count * 4);
+        std::copy_n(poses.pos.data(), count, positions.ptrw());
+        std::copy_n(poses.vel.data(), count, linear_vels.ptrw());
+        std::copy_n(poses.ang.data(), count, angular_vels.ptrw());
+        float* rotation = rotations.ptrw();
+        for (const Quaternion& q : poses.rot)
+        {
+            *rotation++ = q.x;
+            *rotation++ = q.y;
+            *rotation++ = q.z;
+            *rotation++ = q.w;
+        }
+
+        Dictionary result{};
+        result["positions"] = positions;
+        result["rotations"] = rotations;
+        result["linear_vels"] = linear_vels;
+        result["angular_vels"] = angular_vels;
+        result["bone_count"] = sampler.get_bone_count();
+        return result;
+    }
+
 protected:
     static void _bind_methods()
     {
@@ -594,11 +2417,34 @@ protected:
             ClassDB::bind_method(D_METHOD("sample_bone_model_info", "animation_name", "time", "bone_path"), &MMAnimationLibrary::sample_bone_model_info);
             ClassDB::bind_method(D_METHOD("sample_bone_rootmotion_info", "animation_name", "time", "bone_path"), &MMAnimationLibrary::sample_bone_rootmotion_info);
             ClassDB::bind_method(D_METHOD("sample_bone_global_info", "animation_name", "time", "bone_path"), &MMAnimationLibrary::sample_bone_global_info);
+            ClassDB::bind_method(D_METHOD("sample_skeleton", "animation_name", "times", "space"), &MMAnimationLibrary::sample_skeleton, DEFVAL((int)Local));
 
-            ClassDB::bind_method(D_METHOD("bake_data"), &MMAnimationLibrary::bake_data);
+            ClassDB::bind_method(D_METHOD("bake_data", "force_full_bake"), &MMAnimationLibrary::bake_data, DEFVAL(false));
             ClassDB::bind_method(D_METHOD("recalculate_weights"), &MMAnimationLibrary::recalculate_weights);
+            ClassDB::bind_method(D_METHOD("compact_database", "epsilon"), &MMAnimationLibrary::compact_database);
+            ClassDB::bind_method(D_METHOD("append_animation_rows", "animation_name"), &MMAnimationLibrary::append_animation_rows);
+            ClassDB::bind_method(D_METHOD("remove_animation_rows", "animation_name"), &MMAnimationLibrary::remove_animation_rows);
+            ClassDB::bind_method(D_METHOD("get_row_animation_name", "row"), &MMAnimationLibrary::get_row_animation_name);
+            ClassDB::bind_method(D_METHOD("get_row_animation", "row"), &MMAnimationLibrary::get_row_animation);
+            ClassDB::bind_method(D_METHOD("_invalidate_animation_table"), &MMAnimationLibrary::_invalidate_animation_table);
+            ClassDB::bind_method(D_METHOD("save_database"), &MMAnimationLibrary::save_database);
+            ClassDB::bind_method(D_METHOD("build_index", "asynchronous"), &MMAnimationLibrary::build_index, DEFVAL(false));
+            ClassDB::bind_method(D_METHOD("invalidate_index"), &MMAnimationLibrary::invalidate_index);
+            ClassDB::bind_method(D_METHOD("is_index_ready"), &MMAnimationLibrary::is_index_ready);
+            ClassDB::bind_method(D_METHOD("_build_index_task"), &MMAnimationLibrary::_build_index_task);
+            ClassDB::bind_method(D_METHOD("_publish_index"), &MMAnimationLibrary::_publish_index);
+
+            ADD_SIGNAL(MethodInfo("index_ready"));
+            ClassDB::bind_method(D_METHOD("load_database"), &MMAnimationLibrary::load_database);
             ClassDB::bind_method(D_METHOD("check_query_results", "Query", "Result count"), &MMAnimationLibrary::check_query_results);
-            ClassDB::bind_method(D_METHOD("query_pose", "serialized_query", "include_category", "exclude_category"), &MMAnimationLibrary::query_pose, DEFVAL(std::numeric_limits<int64_t>::max()), DEFVAL(0));
+            ClassDB::bind_method(D_METHOD("query_pose", "serialized_query", "include_category", "exclude_category", "weights_override", "lod"), &MMAnimationLibrary::query_pose, DEFVAL(std::numeric_limits<int64_t>::max()), DEFVAL(0), DEFVAL(PackedFloat32Array()), DEFVAL(0));
+            ClassDB::bind_method(D_METHOD("query_pose_packed", "serialized_query", "result", "include_category", "exclude_category", "weights_override", "lod"), &MMAnimationLibrary::query_pose_packed, DEFVAL(std::numeric_limits<int64_t>::max()), DEFVAL(0), DEFVAL(PackedFloat32Array()), DEFVAL(0));
+            ClassDB::bind_method(D_METHOD("get_lod_row_count", "lod"), &MMAnimationLibrary::get_lod_row_count);
+            ClassDB::bind_method(D_METHOD("query_pose_masked", "serialized_query", "dimension_mask", "include_category", "exclude_category"), &MMAnimationLibrary::query_pose_masked, DEFVAL(std::numeric_limits<int64_t>::max()), DEFVAL(0));
+            ClassDB::bind_method(D_METHOD("get_features_mask", "enabled_features"), &MMAnimationLibrary::get_features_mask);
+            ClassDB::bind_method(D_METHOD("get_mirror_bones"), &MMAnimationLibrary::get_mirror_bones);
+            ClassDB::bind_method(D_METHOD("mirror_pose", "pose"), &MMAnimationLibrary::mirror_pose);
+            ClassDB::bind_method(D_METHOD("find_best_entry", "animation_name", "serialized_query"), &MMAnimationLibrary::find_best_entry);
         }
         // Internal properties
         {
@@ -625,6 +2471,15 @@ protected:
             ClassDB::bind_method(D_METHOD("set_db_anim_category", "value"), &MMAnimationLibrary::set_db_anim_category);
             ClassDB::bind_method(D_METHOD("get_db_anim_category"), &MMAnimationLibrary::get_db_anim_category);
             godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_INT32_ARRAY, "db_anim_category", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_STORAGE), "set_db_anim_category", "get_db_anim_category");
+            ClassDB::bind_method(D_METHOD("set_db_anim_bias", "value"), &MMAnimationLibrary::set_db_anim_bias);
+            ClassDB::bind_method(D_METHOD("get_db_anim_bias"), &MMAnimationLibrary::get_db_anim_bias);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "db_anim_bias", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_STORAGE), "set_db_anim_bias", "get_db_anim_bias");
+            ClassDB::bind_method(D_METHOD("set_baked_configuration_hash", "value"), &MMAnimationLibrary::set_baked_configuration_hash);
+            ClassDB::bind_method(D_METHOD("get_baked_configuration_hash"), &MMAnimationLibrary::get_baked_configuration_hash);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "baked_configuration_hash", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_STORAGE), "set_baked_configuration_hash", "get_baked_configuration_hash");
+            ClassDB::bind_method(D_METHOD("set_baked_animation_hashes", "value"), &MMAnimationLibrary::set_baked_animation_hashes);
+            ClassDB::bind_method(D_METHOD("get_baked_animation_hashes"), &MMAnimationLibrary::get_baked_animation_hashes);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::DICTIONARY, "baked_animation_hashes", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_STORAGE), "set_baked_animation_hashes", "get_baked_animation_hashes");
         }
         ClassDB::add_property_group(get_class_static(), "Dependancy resources", "");
         {
@@ -632,6 +2487,36 @@ protected:
             ClassDB::bind_method( D_METHOD("get_time_interval" ), &MMAnimationLibrary::get_time_interval); 
             godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"time_interval",PROPERTY_HINT_RANGE,"0.01,2.0,0.01,or_greater"), "set_time_interval", "get_time_interval");
 
+            ClassDB::bind_method( D_METHOD("set_adaptive_sampling" ,"value"), &MMAnimationLibrary::set_adaptive_sampling); 
+            ClassDB::bind_method( D_METHOD("get_adaptive_sampling" ), &MMAnimationLibrary::get_adaptive_sampling); 
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL,"adaptive_sampling"), "set_adaptive_sampling", "get_adaptive_sampling");
+            ClassDB::bind_method( D_METHOD("set_adaptive_interval" ,"value"), &MMAnimationLibrary::set_adaptive_interval); 
+            ClassDB::bind_method( D_METHOD("get_adaptive_interval" ), &MMAnimationLibrary::get_adaptive_interval); 
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"adaptive_interval",PROPERTY_HINT_RANGE,"0.005,1.0,0.005,or_greater"), "set_adaptive_interval", "get_adaptive_interval");
+            ClassDB::bind_method( D_METHOD("set_adaptive_threshold" ,"value"), &MMAnimationLibrary::set_adaptive_threshold); 
+            ClassDB::bind_method( D_METHOD("get_adaptive_threshold" ), &MMAnimationLibrary::get_adaptive_threshold); 
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"adaptive_threshold",PROPERTY_HINT_RANGE,"0.0,10.0,0.01,or_greater"), "set_adaptive_threshold", "get_adaptive_threshold");
+            ClassDB::bind_method( D_METHOD("set_adaptive_max_gap" ,"value"), &MMAnimationLibrary::set_adaptive_max_gap); 
+            ClassDB::bind_method( D_METHOD("get_adaptive_max_gap" ), &MMAnimationLibrary::get_adaptive_max_gap); 
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"adaptive_max_gap",PROPERTY_HINT_RANGE,"0.01,5.0,0.01,or_greater"), "set_adaptive_max_gap", "get_adaptive_max_gap");
+
+            ClassDB::bind_method(D_METHOD("set_bake_continuations", "value"), &MMAnimationLibrary::set_bake_continuations);
+            ClassDB::bind_method(D_METHOD("get_bake_continuations"), &MMAnimationLibrary::get_bake_continuations);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL, "bake_continuations"), "set_bake_continuations", "get_bake_continuations");
+            ClassDB::bind_method(D_METHOD("set_continuation_count", "value"), &MMAnimationLibrary::set_continuation_count);
+            ClassDB::bind_method(D_METHOD("get_continuation_count"), &MMAnimationLibrary::get_continuation_count);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "continuation_count", PROPERTY_HINT_RANGE, "1,16,1,or_greater"), "set_continuation_count", "get_continuation_count");
+            ClassDB::bind_method(D_METHOD("set_continuation_included_category", "value"), &MMAnimationLibrary::set_continuation_included_category);
+            ClassDB::bind_method(D_METHOD("get_continuation_included_category"), &MMAnimationLibrary::get_continuation_included_category);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "continuation_included_category"), "set_continuation_included_category", "get_continuation_included_category");
+            ClassDB::bind_method(D_METHOD("set_continuation_excluded_category", "value"), &MMAnimationLibrary::set_continuation_excluded_category);
+            ClassDB::bind_method(D_METHOD("get_continuation_excluded_category"), &MMAnimationLibrary::get_continuation_excluded_category);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "continuation_excluded_category"), "set_continuation_excluded_category", "get_continuation_excluded_category");
+            ClassDB::bind_method(D_METHOD("set_continuations", "value"), &MMAnimationLibrary::set_continuations);
+            ClassDB::bind_method(D_METHOD("get_continuations"), &MMAnimationLibrary::get_continuations);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::DICTIONARY, "continuations", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_STORAGE), "set_continuations", "get_continuations");
+            ClassDB::bind_method(D_METHOD("get_animation_continuations", "animation_name"), &MMAnimationLibrary::get_animation_continuations);
+
             ClassDB::bind_method(D_METHOD("set_skeleton_path", "value"), &MMAnimationLibrary::set_skeleton_path);
             ClassDB::bind_method(D_METHOD("get_skeleton_path"), &MMAnimationLibrary::get_skeleton_path);
             godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::STRING_NAME, "skeleton_path"), "set_skeleton_path", "get_skeleton_path");
@@ -646,6 +2531,14 @@ protected:
                 ClassDB::bind_method(D_METHOD("get_category_track_names"), &MMAnimationLibrary::get_category_track_names);
                 godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_STRING_ARRAY, "category_track_names", PROPERTY_HINT_NONE, "", PropertyUsageFlags::PROPERTY_USAGE_DEFAULT), "set_category_track_names", "get_category_track_names");
 
+                ClassDB::bind_method(D_METHOD("set_bias_track_name", "value"), &MMAnimationLibrary::set_bias_track_name);
+                ClassDB::bind_method(D_METHOD("get_bias_track_name"), &MMAnimationLibrary::get_bias_track_name);
+                godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::STRING, "bias_track_name"), "set_bias_track_name", "get_bias_track_name");
+
+                ClassDB::bind_method(D_METHOD("set_animation_biases", "value"), &MMAnimationLibrary::set_animation_biases);
+                ClassDB::bind_method(D_METHOD("get_animation_biases"), &MMAnimationLibrary::get_animation_biases);
+                godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::DICTIONARY, "animation_biases"), "set_animation_biases", "get_animation_biases");
+
                 ClassDB::bind_method(D_METHOD("set_motion_features", "value"), &MMAnimationLibrary::set_motion_features);
                 ClassDB::bind_method(D_METHOD("get_motion_features"), &MMAnimationLibrary::get_motion_features);
                 godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::ARRAY, "motion_features", godot::PROPERTY_HINT_TYPE_STRING, u::str(Variant::OBJECT) + '/' + u::str(Variant::BASIS) + ":MotionFeature", PROPERTY_USAGE_DEFAULT), "set_motion_features", "get_motion_features");
@@ -658,9 +2551,40 @@ protected:
             ClassDB::bind_method(D_METHOD("set_distance_type", "value"), &MMAnimationLibrary::set_distance_type);
             ClassDB::bind_method(D_METHOD("get_distance_type"), &MMAnimationLibrary::get_distance_type);
             godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "distance_type", PROPERTY_HINT_ENUM, "Manhattan:1,EuclidianSquared:2,Maximum:0"), "set_distance_type", "get_distance_type");
+            ClassDB::bind_method(D_METHOD("set_async_index_build", "value"), &MMAnimationLibrary::set_async_index_build);
+            ClassDB::bind_method(D_METHOD("get_async_index_build"), &MMAnimationLibrary::get_async_index_build);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL, "async_index_build"), "set_async_index_build", "get_async_index_build");
+            ClassDB::bind_method(D_METHOD("set_refine_timestamp", "value"), &MMAnimationLibrary::set_refine_timestamp);
+            ClassDB::bind_method(D_METHOD("get_refine_timestamp"), &MMAnimationLibrary::get_refine_timestamp);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL, "refine_timestamp"), "set_refine_timestamp", "get_refine_timestamp");
+            ClassDB::bind_method(D_METHOD("set_refine_iterations", "value"), &MMAnimationLibrary::set_refine_iterations);
+            ClassDB::bind_method(D_METHOD("get_refine_iterations"), &MMAnimationLibrary::get_refine_iterations);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "refine_iterations", PROPERTY_HINT_RANGE, "1,30,1"), "set_refine_iterations", "get_refine_iterations");
+            ClassDB::bind_method(D_METHOD("set_mirror_search", "value"), &MMAnimationLibrary::set_mirror_search);
+            ClassDB::bind_method(D_METHOD("get_mirror_search"), &MMAnimationLibrary::get_mirror_search);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL, "mirror_search"), "set_mirror_search", "get_mirror_search");
+            ClassDB::bind_method(D_METHOD("set_playback_rates", "value"), &MMAnimationLibrary::set_playback_rates);
+            ClassDB::bind_method(D_METHOD("get_playback_rates"), &MMAnimationLibrary::get_playback_rates);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "playback_rates"), "set_playback_rates", "get_playback_rates");
+            ClassDB::bind_method(D_METHOD("set_lod_row_steps", "value"), &MMAnimationLibrary::set_lod_row_steps);
+            ClassDB::bind_method(D_METHOD("get_lod_row_steps"), &MMAnimationLibrary::get_lod_row_steps);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_INT32_ARRAY, "lod_row_steps"), "set_lod_row_steps", "get_lod_row_steps");
+            ClassDB::bind_method(D_METHOD("set_lod_features", "value"), &MMAnimationLibrary::set_lod_features);
+            ClassDB::bind_method(D_METHOD("get_lod_features"), &MMAnimationLibrary::get_lod_features);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::ARRAY, "lod_features", PROPERTY_HINT_TYPE_STRING, String::num(Variant::PACKED_INT32_ARRAY) + ":"), "set_lod_features", "get_lod_features");
+            ClassDB::bind_method(D_METHOD("set_max_index_segments", "value"), &MMAnimationLibrary::set_max_index_segments);
+            ClassDB::bind_method(D_METHOD("get_max_index_segments"), &MMAnimationLibrary::get_max_index_segments);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "max_index_segments", PROPERTY_HINT_RANGE, "1,64,1"), "set_max_index_segments", "get_max_index_segments");
             ClassDB::bind_method(D_METHOD("set_weights", "value"), &MMAnimationLibrary::set_weights);
             ClassDB::bind_method(D_METHOD("get_weights"), &MMAnimationLibrary::get_weights);
             godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "weights"), "set_weights", "get_weights");
+
+            ClassDB::bind_method(D_METHOD("set_database_path", "value"), &MMAnimationLibrary::set_database_path);
+            ClassDB::bind_method(D_METHOD("get_database_path"), &MMAnimationLibrary::get_database_path);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::STRING, "database_path", PROPERTY_HINT_SAVE_FILE, "*.mmdb"), "set_database_path", "get_database_path");
+            ClassDB::bind_method(D_METHOD("set_database_compression", "value"), &MMAnimationLibrary::set_database_compression);
+            ClassDB::bind_method(D_METHOD("get_database_compression"), &MMAnimationLibrary::get_database_compression);
+            godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "database_compression", PROPERTY_HINT_ENUM, "None:0,Zstd:1,Deflate:2"), "set_database_compression", "get_database_compression");
         }
     }
 public :
@@ -30,6 +30,7 @@
 
 #include <KForm.hpp>
 #include <Spring.hpp>
+#include <MMAnimationLibrary.hpp>
 #include <numeric>
 
 // Macro setup. Mostly there to simplify writing all those
@@ -68,6 +69,41 @@ struct MMAnimationPlayer : godot::AnimationPlayer
     Ref<Animation> pending_desired_anim = nullptr;
     float pending_desired_time = 0.0f;
 
+    // The current animation is played mirrored, left and right swapped (see MMAnimationLibrary::mirror_search) :
+    // each bone plays the tracks of its mirror, mirrored across the YZ plane of the bone.
+    // The bones of a pair must have mirrored rests, as the humanoid skeletons imported by Godot.
+    // The AnimationPlayer root motion isn't mirrored, get_inertialized_root_motion_velocity is.
+    bool mirrored = false;
+    bool is_mirrored(){return mirrored;}
+    std::vector<int32_t> mirror_bones{}; // Bone on the other side for each bone of the skeleton.
+
+    void _setup_mirror_bones()
+    {
+        const int32_t bone_count = _skeleton->get_bone_count();
+        if ((int32_t)mirror_bones.size() == bone_count)
+        {
+            return;
+        }
+        mirror_bones.resize(bone_count);
+        for (int32_t bone = 0; bone < bone_count; ++bone)
+        {
+            const int32_t mirror = _skeleton->find_bone(MotionFeature::mirror_bone_name(_skeleton->get_bone_name(bone)));
+            mirror_bones[bone] = mirror != -1 ? mirror : bone;
+        }
+    }
+
+    // Track path of the bone animated on bone_id, its mirror when playing mirrored.
+    String _source_bone_path(int32_t bone_id)
+    {
+        const int32_t source = mirrored ? mirror_bones[bone_id] : bone_id;
+        return u::str(skeleton_path) + String(":") + _skeleton->get_bone_name(source);
+    }
+
+    static Vector3 _mirror_vector(Vector3 v) { return Vector3(-v.x, v.y, v.z); }
+    // Rotations and angular velocities are pseudo vectors : the axis is mirrored then negated.
+    static Quaternion _mirror_rotation(Quaternion q) { return Quaternion(q.x, -q.y, -q.z, q.w); }
+    static Vector3 _mirror_angular(Vector3 v) { return Vector3(v.x, -v.y, -v.z); }
+
     virtual void _ready() override
     {
         AnimationPlayer::_ready();
@@ -124,7 +160,38 @@ struct MMAnimationPlayer : godot::AnimationPlayer
         stop();
     }
 
-    virtual bool request_animation(StringName p_animation_name, float p_time = 0.0f,float new_halflife = -1.0f, float time_diff = -1.0f)
+    // Play an animation of the MMAnimationLibrary library_name from its pose closest to the query,
+    // see MMAnimationLibrary::find_best_entry.
+    bool request_best_entry(StringName library_name, StringName animation_name, PackedFloat32Array query, float new_halflife = -1.0f)
+    {
+        Ref<MMAnimationLibrary> library = get_animation_library(library_name);
+        ERR_FAIL_COND_V_MSG(library.is_null(), false, "No MMAnimationLibrary named '" + String(library_name) + "'");
+        const Dictionary entry = library->find_best_entry(animation_name, query);
+        if (entry.is_empty())
+        {
+            return false;
+        }
+        const StringName full_name = String(library_name).is_empty() ? animation_name : StringName(String(library_name) + "/" + String(animation_name));
+        return request_animation(full_name, entry["timestamp"], new_halflife);
+    }
+
+    // Play a match returned by MMAnimationLibrary::query_pose, from the library library_name.
+    // The speed_scale is set to the rate of the match, even when the request is skipped because the animation
+    // is already playing there, and the animation is mirrored if the match is.
+    bool request_match(StringName library_name, Dictionary match, float new_halflife = -1.0f, float time_diff = -1.0f)
+    {
+        ERR_FAIL_COND_V_MSG(!match.has("animation") || !match.has("timestamp"), false, "The match must have an animation and a timestamp");
+        const StringName animation_name = match["animation"];
+        const StringName full_name = String(library_name).is_empty() ? animation_name : StringName(String(library_name) + "/" + String(animation_name));
+        const bool match_mirrored = match.get("mirrored", false);
+        const bool started = request_animation(full_name, match["timestamp"], new_halflife, time_diff, match_mirrored);
+        set_speed_scale(match.get("rate", 1.0f));
+        return started;
+    }
+
+    // With p_mirrored, the animation is played mirrored, see mirrored. The animation starts at its own rate,
+    // speed_scale is reset to 1 (request_match sets it afterwards).
+    virtual bool request_animation(StringName p_animation_name, float p_time = 0.0f,float new_halflife = -1.0f, float time_diff = -1.0f, bool p_mirrored = false)
     {
         _skeleton = get_node<Skeleton3D>(NodePath(skeleton_path));
         ERR_FAIL_NULL_V(_skeleton,false);
@@ -135,11 +202,17 @@ struct MMAnimationPlayer : godot::AnimationPlayer
         bones_kform.reserve(_skeleton->get_bone_count());
         bones_offset.reserve(_skeleton->get_bone_count());
         //
-        if(time_diff > 0.0f && p_animation_name == get_current_animation() && abs(p_time - get_current_animation_position()) < time_diff)
+        if(time_diff > 0.0f && p_animation_name == get_current_animation() && p_mirrored == mirrored && abs(p_time - get_current_animation_position()) < time_diff)
         {
             // We are already playing
             return false;
         }
+        mirrored = p_mirrored;
+        if (mirrored)
+        {
+            _setup_mirror_bones();
+        }
+        set_speed_scale(1.0f);
         if ( new_halflife > 0.0f)
         {
             set_halflife(new_halflife);
@@ -160,9 +233,10 @@ struct MMAnimationPlayer : godot::AnimationPlayer
         {
             const Transform3D bone_rest = _skeleton->get_bone_rest(bone_id);
             const String bone_path = u::str(skeleton_path) + String(":") + _skeleton->get_bone_name(bone_id);
+            const String source_path = _source_bone_path(bone_id);
 
-            auto track_pos = p_animation->find_track(bone_path, Animation::TrackType::TYPE_POSITION_3D);
-            auto track_rot = p_animation->find_track(bone_path, Animation::TrackType::TYPE_ROTATION_3D);
+            auto track_pos = p_animation->find_track(source_path, Animation::TrackType::TYPE_POSITION_3D);
+            auto track_rot = p_animation->find_track(source_path, Animation::TrackType::TYPE_ROTATION_3D);
 
             //POSITION 3D
                 Vector3 desired_position = bones_kform.pos[bone_id] ,// _skeleton->get_bone_pose_position(bone_id),
@@ -171,6 +245,11 @@ struct MMAnimationPlayer : godot::AnimationPlayer
                 {
                     desired_position = p_animation->position_track_interpolate(track_pos, p_time)* motion_scale ;
                     desired_linear_vel = ((p_animation->position_track_interpolate(track_pos, future_time)* motion_scale)- desired_position) / abs(future_time - p_time);
+                    if (mirrored)
+                    {
+                        desired_position = _mirror_vector(desired_position);
+                        desired_linear_vel = _mirror_vector(desired_linear_vel);
+                    }
                 }
 
             //ROTATION 3D
@@ -181,6 +260,11 @@ struct MMAnimationPlayer : godot::AnimationPlayer
                     desired_rotation = p_animation->rotation_track_interpolate(track_rot, p_time).normalized();
                     Quaternion r1 = p_animation->rotation_track_interpolate(track_rot, future_time).normalized();
                     desired_angular_vel = Spring::quat_differentiate_angular_velocity(r1,desired_rotation,abs(future_time - p_time)).normalized();
+                    if (mirrored)
+                    {
+                        desired_rotation = _mirror_rotation(desired_rotation);
+                        desired_angular_vel = _mirror_angular(desired_angular_vel);
+                    }
                 }
 
 
@@ -212,6 +296,46 @@ struct MMAnimationPlayer : godot::AnimationPlayer
     }
 
 
+    // When a clip ends, play its first continuation baked by its MMAnimationLibrary (see bake_continuations)
+    // instead of holding the last pose until the next search. continuation_started is emitted, so a real search
+    // can validate the choice later.
+    GETSET(bool,play_continuations,true);
+
+    bool _play_continuation(StringName p_animation_name)
+    {
+        const String full_name = p_animation_name;
+        const int32_t separator = full_name.find("/");
+        const String library_name = separator == -1 ? String() : full_name.substr(0, separator);
+        const String animation_name = separator == -1 ? full_name : full_name.substr(separator + 1);
+        if (!has_animation_library(library_name))
+        {
+            return false;
+        }
+        Ref<MMAnimationLibrary> library = get_animation_library(library_name);
+        if (library.is_null())
+        {
+            return false;
+        }
+        const Array candidates = library->get_animation_continuations(animation_name);
+        for (int64_t i = 0; i < candidates.size(); ++i)
+        {
+            const Dictionary candidate = candidates[i];
+            const StringName candidate_name = library_name.is_empty() ? String(candidate["animation"]) : library_name + "/" + String(candidate["animation"]);
+            if (!has_animation(candidate_name))
+            {
+                continue;
+            }
+            // A mirrored clip continues with the mirrored continuation.
+            const float timestamp = candidate["timestamp"];
+            if (request_animation(candidate_name, timestamp, -1.0f, -1.0f, mirrored))
+            {
+                emit_signal("continuation_started", candidate_name, timestamp);
+                return true;
+            }
+        }
+        return false;
+    }
+
     void _on_anim_finish(StringName p_animation_name)
     {
         set_halflife(default_halflife);
@@ -221,6 +345,10 @@ struct MMAnimationPlayer : godot::AnimationPlayer
         last_anim = p_animation_name;
         last_timestamp = p_time;
 
+        if (play_continuations)
+        {
+            _play_continuation(p_animation_name);
+        }
         return;
     }
 
@@ -258,17 +386,25 @@ struct MMAnimationPlayer : godot::AnimationPlayer
                 desired = bones_kform[bone_id];
                 
                 const Transform3D bone_rest = _skeleton->get_bone_rest(bone_id).scaled_local(Vector3(1,1,1) * motion_scale);
-                const String bone_path = u::str(skeleton_path) + String(":") + _skeleton->get_bone_name(bone_id);
+                const String bone_path = _source_bone_path(bone_id);
 
                 auto track_pos = animation->find_track(bone_path, Animation::TrackType::TYPE_POSITION_3D);
                 if(track_pos != -1)
                 {
                     desired.pos = animation->position_track_interpolate(track_pos, last_timestamp) * motion_scale;
+                    if (mirrored)
+                    {
+                        desired.pos = _mirror_vector(desired.pos);
+                    }
                 }
                 auto track_rot = animation->find_track(bone_path, Animation::TrackType::TYPE_ROTATION_3D);
                 if(track_rot != -1)
                 {
                     desired.rot = animation->rotation_track_interpolate(track_rot, last_timestamp);
+                    if (mirrored)
+                    {
+                        desired.rot = _mirror_rotation(desired.rot);
+                    }
                 }
 
                 if (bone_id == root_bone_id)
@@ -302,8 +438,9 @@ struct MMAnimationPlayer : godot::AnimationPlayer
                 desired.ang = Vector3();
 
 
-                const int track_pos = animation->find_track(bone_path,Animation::TrackType::TYPE_POSITION_3D);
-                const int track_rot = animation->find_track(bone_path,Animation::TrackType::TYPE_ROTATION_3D);
+                const String source_path = mirrored ? _source_bone_path(bone_id) : bone_path;
+                const int track_pos = animation->find_track(source_path,Animation::TrackType::TYPE_POSITION_3D);
+                const int track_rot = animation->find_track(source_path,Animation::TrackType::TYPE_ROTATION_3D);
                 if(track_pos != -1)
                 {
                     desired.pos = animation->position_track_interpolate(track_pos, current_time) * motion_scale;
@@ -314,6 +451,14 @@ struct MMAnimationPlayer : godot::AnimationPlayer
                     desired.rot = animation->rotation_track_interpolate(track_rot, current_time);
                     desired.ang = u::is_zero_approx(delta_diff) ? Vector3() : Spring::quat_differentiate_angular_velocity( animation->rotation_track_interpolate(track_rot, future_time), desired.rot,delta_diff);
                 }
+                if (mirrored)
+                {
+                    // Without a track for its mirror, the bone keeps the pose set by the AnimationPlayer.
+                    desired.pos = track_pos != -1 ? _mirror_vector(desired.pos) : desired.pos;
+                    desired.vel = _mirror_vector(desired.vel);
+                    desired.rot = track_rot != -1 ? _mirror_rotation(desired.rot) : desired.rot;
+                    desired.ang = _mirror_angular(desired.ang);
+                }
  
                 if (bone_id == root_bone_id)
                 {
@@ -485,9 +630,13 @@ struct MMAnimationPlayer : godot::AnimationPlayer
     static void _bind_methods()
     {
         ClassDB::bind_method(D_METHOD("_on_anim_finish","anim"),&MMAnimationPlayer::_on_anim_finish);
+        ADD_SIGNAL(MethodInfo("continuation_started", PropertyInfo(Variant::STRING_NAME, "animation"), PropertyInfo(Variant::FLOAT, "timestamp")));
 
-        ClassDB::bind_method(D_METHOD("request_animation", "animation", "timestamp", "new_halflife","skip_same_anim_difference"), &MMAnimationPlayer::request_animation, (0.0f),(-1.0f),(-1.0f));
+        ClassDB::bind_method(D_METHOD("request_animation", "animation", "timestamp", "new_halflife","skip_same_anim_difference","mirrored"), &MMAnimationPlayer::request_animation, (0.0f),(-1.0f),(-1.0f),(false));
+        ClassDB::bind_method(D_METHOD("is_mirrored"), &MMAnimationPlayer::is_mirrored);
+        ClassDB::bind_method(D_METHOD("request_match", "library", "match", "new_halflife", "skip_same_anim_difference"), &MMAnimationPlayer::request_match, DEFVAL(-1.0f), DEFVAL(-1.0f));
         ClassDB::bind_method(D_METHOD("request_pose", "animation", "timestamp", "new_halflife"), &MMAnimationPlayer::request_pose, (0.0f),(-1.0f));
+        ClassDB::bind_method(D_METHOD("request_best_entry", "library", "animation", "serialized_query", "new_halflife"), &MMAnimationPlayer::request_best_entry, DEFVAL(-1.0f));
         
 
         ClassDB::bind_method(D_METHOD("get_local_bone_info","bone_name"),&MMAnimationPlayer::get_local_bone_info);
@@ -502,5 +651,9 @@ struct MMAnimationPlayer : godot::AnimationPlayer
         godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"halflife"
         , PROPERTY_HINT_RANGE, "0.0,1.0,0.01,or_greater"), "set_halflife", "get_halflife");
 
+        ClassDB::bind_method( D_METHOD("set_play_continuations" ,"value"), &MMAnimationPlayer::set_play_continuations);
+        ClassDB::bind_method( D_METHOD("get_play_continuations" ), &MMAnimationPlayer::get_play_continuations);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL,"play_continuations"), "set_play_continuations", "get_play_continuations");
+
     }
 };
\ No newline at end of file
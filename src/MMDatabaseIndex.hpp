@@ -0,0 +1,310 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include "kdtree-cpp/kdtree.hpp"
+
+using namespace godot;
+
+/// @brief Search index of a baked database.
+/// Built from a copy of the data, and never modified after, so it can be built on a worker thread
+/// and read by the queries while the library data changes.
+/// Rows appended after the build go in small segments with their own kdtree, and removed rows are only
+/// flagged : with_appended_rows() and with_removed_rows() return a new index sharing the existing segments.
+/// The library merges everything back in a single segment in the background.
+/// Rows can have a cost bias, added to their distance by the k nearest neighbors search.
+struct MMDatabaseIndex
+{
+    // Rows whose category has this bit are never returned (the DONOTUSE category bit).
+    static constexpr int32_t removed_category_bit = int32_t(1u << 31);
+
+    struct Segment
+    {
+        std::shared_ptr<Kdtree::KdTree> tree{};
+        std::shared_ptr<std::vector<int32_t>> categories{}; // The kdtree nodes data point in there.
+        int64_t row_offset = 0; // Row of the library of the first node.
+    };
+
+    uint64_t content_hash = 0;
+    int32_t nb_dimensions = 0;
+    int distance_type = 1;
+    std::shared_ptr<const std::vector<float>> weights{};
+    std::vector<Segment> segments{};
+    std::shared_ptr<const std::vector<bool>> removed{}; // Rows removed after the segments were built, may be null.
+
+    // biases may be null when the rows have none.
+    static Segment _build_segment(const float* data, const int32_t* categories, const float* biases, int64_t row_count, int64_t row_offset, int32_t nb_dimensions, int distance_type, const std::vector<float>& weights)
+    {
+        Segment segment{};
+        segment.row_offset = row_offset;
+        segment.categories = std::make_shared<std::vector<int32_t>>(categories, categories + row_count);
+        Kdtree::KdNodeVector nodes{};
+        nodes.reserve(row_count);
+        for (int64_t row = 0; row < row_count; ++row)
+        {
+            const float* begin = data + row * nb_dimensions;
+            nodes.emplace_back(Kdtree::CoordPoint(begin, begin + nb_dimensions), &(*segment.categories)[row], (int)row, biases != nullptr ? biases[row] : 0.0f);
+        }
+        segment.tree = std::make_shared<Kdtree::KdTree>(&nodes, distance_type);
+        segment.tree->set_distance(distance_type, &weights);
+        return segment;
+    }
+
+    // biases is empty when the rows have none.
+    static std::shared_ptr<MMDatabaseIndex> build(const PackedFloat32Array& data, const PackedInt32Array& categories, int32_t nb_dimensions, int distance_type, const PackedFloat32Array& weights, const PackedFloat32Array& biases)
+    {
+        ERR_FAIL_COND_V(nb_dimensions <= 0 || data.size() != categories.size() * nb_dimensions, nullptr);
+        ERR_FAIL_COND_V(categories.is_empty(), nullptr);
+        ERR_FAIL_COND_V(!biases.is_empty() && biases.size() != categories.size(), nullptr);
+        auto index = std::make_shared<MMDatabaseIndex>();
+        index->nb_dimensions = nb_dimensions;
+        index->distance_type = distance_type;
+        auto index_weights = std::make_shared<std::vector<float>>(nb_dimensions, 1.0f);
+        std::copy_n(weights.ptr(), std::min<int64_t>(weights.size(), nb_dimensions), index_weights->begin());
+        index->weights = index_weights;
+        index->segments.push_back(_build_segment(data.ptr(), categories.ptr(), biases.is_empty() ? nullptr : biases.ptr(), categories.size(), 0, nb_dimensions, distance_type, *index_weights));
+        return index;
+    }
+
+    // Same index, with the rows [row_offset, row_offset + row_count[ in a new segment.
+    std::shared_ptr<MMDatabaseIndex> with_appended_rows(const float* data, const int32_t* categories, const float* biases, int64_t row_count, int64_t row_offset) const
+    {
+        auto index = std::make_shared<MMDatabaseIndex>(*this);
+        index->content_hash = 0;
+        if (row_count > 0)
+        {
+            index->segments.push_back(_build_segment(data, categories, biases, row_count, row_offset, nb_dimensions, distance_type, *weights));
+        }
+        return index;
+    }
+
+    // Same index, ignoring the rows flagged in p_removed.
+    std::shared_ptr<MMDatabaseIndex> with_removed_rows(std::shared_ptr<const std::vector<bool>> p_removed) const
+    {
+        auto index = std::make_shared<MMDatabaseIndex>(*this);
+        index->content_hash = 0;
+        index->removed = std::move(p_removed);
+        return index;
+    }
+
+    int64_t get_row_count() const
+    {
+        int64_t count = 0;
+        for (const auto& segment : segments)
+        {
+            count += segment.categories->size();
+        }
+        return count;
+    }
+
+    // Rows appended after with_removed_rows() are past the end of removed.
+    bool _is_removed(int64_t row) const
+    {
+        return removed != nullptr && row < (int64_t)removed->size() && (*removed)[row];
+    }
+
+    int64_t get_segment_count() const { return segments.size(); }
+
+    // custom_weights replace the weights of the index, see k_nearest_rows.
+    float distance(const float* a, const float* b, const float* custom_weights = nullptr) const
+    {
+        const float* w = custom_weights != nullptr ? custom_weights : weights->data();
+        float result = 0.0f;
+        for (int32_t i = 0; i < nb_dimensions; ++i)
+        {
+            const float d = std::abs(a[i] - b[i]);
+            switch (distance_type)
+            {
+            case 0: result = std::max(result, w[i] * d); break;
+            case 1: result += w[i] * d; break;
+            default: result += w[i] * d * d; break;
+            }
+        }
+        return result;
+    }
+
+    // Skips the removed rows, then asks the user predicate.
+    struct SegmentPredicate : Kdtree::KdNodePredicate
+    {
+        const MMDatabaseIndex* index = nullptr;
+        const Segment* segment = nullptr;
+        const Kdtree::KdNodePredicate* pred = nullptr;
+        virtual bool operator()(const Kdtree::KdNode& node) const
+        {
+            if (*(const int32_t*)node.data & removed_category_bit)
+            {
+                return false;
+            }
+            if (index->_is_removed(segment->row_offset + node.index))
+            {
+                return false;
+            }
+            return pred == nullptr || (*pred)(node);
+        }
+    };
+
+    // Rows of the k nearest neighbors, closest first, and their distances if asked.
+    // custom_weights (nb_dimensions non negative values) replace the weights of the index for this query only.
+    // They're read in place by the distance and the pruning, the trees don't depend on the weights :
+    // a dimension weighted 0 is ignored.
+    void k_nearest_rows(const float* query, size_t k, std::vector<int64_t>& rows, const Kdtree::KdNodePredicate* pred = nullptr, std::vector<float>* distances = nullptr, const float* custom_weights = nullptr) const
+    {
+        const Kdtree::CoordPoint point(query, query + nb_dimensions);
+        std::vector<std::pair<float, int64_t>> best{};
+        Kdtree::KdNodeVector result{};
+        for (const auto& segment : segments)
+        {
+            SegmentPredicate segment_pred{};
+            segment_pred.index = this;
+            segment_pred.segment = &segment;
+            segment_pred.pred = pred;
+            segment.tree->k_nearest_neighbors(point, k, &result, &segment_pred, custom_weights);
+            for (const auto& node : result)
+            {
+                best.emplace_back(distance(query, node.point.data(), custom_weights) + node.bias, segment.row_offset + node.index);
+            }
+        }
+        if (segments.size() > 1)
+        {
+            std::sort(best.begin(), best.end());
+        }
+        best.resize(std::min(k, best.size()));
+        rows.clear();
+        if (distances != nullptr)
+        {
+            distances->clear();
+        }
+        for (const auto& [dist, row] : best)
+        {
+            rows.push_back(row);
+            if (distances != nullptr)
+            {
+                distances->push_back(dist);
+            }
+        }
+    }
+
+    // Rows within radius of the query, in no particular order. The biases are ignored.
+    void range_rows(const float* query, float radius, std::vector<int64_t>& rows) const
+    {
+        const Kdtree::CoordPoint point(query, query + nb_dimensions);
+        Kdtree::KdNodeVector result{};
+        rows.clear();
+        for (const auto& segment : segments)
+        {
+            segment.tree->range_nearest_neighbors(point, radius, &result);
+            for (const auto& node : result)
+            {
+                const int64_t row = segment.row_offset + node.index;
+                if ((*(const int32_t*)node.data & removed_category_bit) || _is_removed(row))
+                {
+                    continue;
+                }
+                rows.push_back(row);
+            }
+        }
+    }
+};
+
+/// @brief Process-wide cache of the built indices, keyed by the hash of what they were built from.
+/// Libraries with the same baked content (duplicates, local to scene copies, several characters) share one index.
+/// The cache only holds weak references, an index is freed with the last library using it.
+struct MMDatabaseRegistry
+{
+    static inline std::mutex mutex{};
+    static inline std::unordered_map<uint64_t, std::weak_ptr<MMDatabaseIndex>> indices{};
+
+    static uint64_t _hash_bytes(const void* bytes, size_t size, uint64_t hash)
+    {
+        // FNV-1a on 64 bits words, the tail is padded with zeros.
+        const uint8_t* data = static_cast<const uint8_t*>(bytes);
+        for (size_t i = 0; i < size; i += sizeof(uint64_t))
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, data + i, std::min(sizeof(uint64_t), size - i));
+            hash ^= word;
+            hash *= 0x100000001b3ULL;
+        }
+        hash ^= size;
+        hash *= 0x100000001b3ULL;
+        return hash;
+    }
+
+    static uint64_t content_hash(const PackedFloat32Array& data, const PackedInt32Array& categories, int32_t nb_dimensions, int distance_type, const PackedFloat32Array& weights, const PackedFloat32Array& biases)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        const int64_t header[2] = {nb_dimensions, distance_type};
+        hash = _hash_bytes(header, sizeof(header), hash);
+        hash = _hash_bytes(data.ptr(), data.size() * sizeof(float), hash);
+        hash = _hash_bytes(categories.ptr(), categories.size() * sizeof(int32_t), hash);
+        hash = _hash_bytes(weights.ptr(), weights.size() * sizeof(float), hash);
+        hash = _hash_bytes(biases.ptr(), biases.size() * sizeof(float), hash);
+        return hash;
+    }
+
+    // Index of this content, built if no library uses one yet.
+    // The build happens outside of the lock, if two threads build the same content the first one published wins.
+    static std::shared_ptr<MMDatabaseIndex> acquire(const PackedFloat32Array& data, const PackedInt32Array& categories, int32_t nb_dimensions, int distance_type, const PackedFloat32Array& weights, const PackedFloat32Array& biases)
+    {
+        const uint64_t hash = content_hash(data, categories, nb_dimensions, distance_type, weights, biases);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (auto shared = _find(hash, categories.size(), nb_dimensions, distance_type))
+            {
+                return shared;
+            }
+        }
+        auto built = MMDatabaseIndex::build(data, categories, nb_dimensions, distance_type, weights, biases);
+        if (built == nullptr)
+        {
+            return nullptr;
+        }
+        built->content_hash = hash;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto shared = _find(hash, categories.size(), nb_dimensions, distance_type))
+        {
+            return shared;
+        }
+        indices[hash] = built;
+        return built;
+    }
+
+    // Number of indices alive, for debugging.
+    static int64_t get_index_count()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t count = 0;
+        for (const auto& [hash, index] : indices)
+        {
+            count += index.expired() ? 0 : 1;
+        }
+        return count;
+    }
+
+    // Must be called with the mutex locked. Drops the expired entries on the way.
+    // An index with the same hash but another shape is a collision, it isn't returned (and is replaced in the cache).
+    static std::shared_ptr<MMDatabaseIndex> _find(uint64_t hash, int64_t row_count, int32_t nb_dimensions, int distance_type)
+    {
+        for (auto it = indices.begin(); it != indices.end();)
+        {
+            it = it->second.expired() ? indices.erase(it) : std::next(it);
+        }
+        const auto it = indices.find(hash);
+        auto shared = it != indices.end() ? it->second.lock() : nullptr;
+        if (shared != nullptr && (shared->get_row_count() != row_count || shared->nb_dimensions != nb_dimensions || shared->distance_type != distance_type))
+        {
+            return nullptr;
+        }
+        return shared;
+    }
+};
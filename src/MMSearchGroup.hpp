@@ -0,0 +1,197 @@
+#pragma once
+
+#include <godot_cpp/variant/utility_functions.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/typed_array.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/method_bind.hpp>
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "MMAnimationLibrary.hpp"
+
+using namespace godot;
+
+/// @brief Several libraries searched as one database (locomotion, combat, traversal...).
+/// Every library keeps its own index, the group searches all of them with the same query,
+/// on the worker threads, and returns the best match once each library cost is biased.
+/// The libraries must be baked with the same features and distance, so their rows have the same layout
+/// and their costs the same scale.
+/// query_pose must be called from the main thread : the libraries build and publish their indices there.
+struct MMSearchGroup : public RefCounted
+{
+    GDCLASS(MMSearchGroup,RefCounted)
+    using u = godot::UtilityFunctions;
+
+    GETSET(TypedArray<MMAnimationLibrary>,libraries);
+    // Added to the cost of every match of the library with the same position, 0 when missing.
+    // A positive bias makes a library less likely to win.
+    GETSET(PackedFloat32Array,library_biases);
+    // Below this many libraries the searches run on the calling thread, a task costs more than a small search.
+    GETSET(int,min_parallel_libraries,2);
+
+    struct LibrarySearch
+    {
+        MMAnimationLibrary* library = nullptr;
+        std::shared_ptr<MMDatabaseIndex> index{};
+        float bias = 0.0f;
+        int64_t row = -1;
+        float cost = std::numeric_limits<float>::max();
+    };
+
+    // State of one query_pose call, owned by the call and given to its group task.
+    struct GroupSearch
+    {
+        std::vector<LibrarySearch> searches{};
+        const float* query = nullptr;
+        const Kdtree::KdNodePredicate* pred = nullptr;
+    };
+
+    // Error message if the libraries can't be searched together, empty otherwise.
+    // Their features must match one to one (class and dimension), and their costs must use the same distance.
+    String get_configuration_error()
+    {
+        const MMAnimationLibrary* first = nullptr;
+        for (int64_t i = 0; i < libraries.size(); ++i)
+        {
+            const MMAnimationLibrary* library = Object::cast_to<MMAnimationLibrary>(libraries[i]);
+            if (library == nullptr)
+            {
+                return "Library " + u::str(i) + " is null";
+            }
+            if (library->nb_dimensions == 0)
+            {
+                return "Library " + u::str(i) + " isn't baked";
+            }
+            if (first == nullptr)
+            {
+                first = library;
+                continue;
+            }
+            if (library->nb_dimensions != first->nb_dimensions)
+            {
+                return "Library " + u::str(i) + " has " + u::str(library->nb_dimensions) + " dimensions instead of " + u::str(first->nb_dimensions);
+            }
+            if (library->distance_type != first->distance_type)
+            {
+                return "Library " + u::str(i) + " uses distance type " + u::str(library->distance_type) + " instead of " + u::str(first->distance_type);
+            }
+            if (library->motion_features.size() != first->motion_features.size())
+            {
+                return "Library " + u::str(i) + " has " + u::str(library->motion_features.size()) + " features instead of " + u::str(first->motion_features.size());
+            }
+            for (int64_t f = 0; f < first->motion_features.size(); ++f)
+            {
+                MotionFeature* feature = Object::cast_to<MotionFeature>(library->motion_features[f]);
+                MotionFeature* first_feature = Object::cast_to<MotionFeature>(first->motion_features[f]);
+                if (feature == nullptr || first_feature == nullptr)
+                {
+                    return "Library " + u::str(i) + " feature " + u::str(f) + " is null";
+                }
+                if (feature->get_class() != first_feature->get_class() || feature->get_dimension() != first_feature->get_dimension())
+                {
+                    return "Library " + u::str(i) + " feature " + u::str(f) + " doesn't match the feature of library 0";
+                }
+            }
+        }
+        return "";
+    }
+
+    // Group task of query_pose, group_search is its GroupSearch.
+    static void _search_library(void* group_search, uint32_t library_index)
+    {
+        GroupSearch& group = *static_cast<GroupSearch*>(group_search);
+        LibrarySearch& search = group.searches[library_index];
+        std::vector<int64_t> rows{};
+        std::vector<float> distances{};
+        search.library->_search_with(search.index, group.query, 1, rows, group.pred, &distances);
+        if (!rows.empty())
+        {
+            search.row = rows[0];
+            search.cost = distances[0] + search.bias;
+        }
+    }
+
+    // Best pose of all the libraries : animation, timestamp, cost, library and library_index.
+    // Empty if no pose matches the categories.
+    Dictionary query_pose(PackedFloat32Array query, int64_t included_category = std::numeric_limits<int64_t>::max(), int64_t excluded_category = 0)
+    {
+        const String error = get_configuration_error();
+        ERR_FAIL_COND_V_MSG(!error.is_empty(), {}, error);
+        ERR_FAIL_COND_V_MSG(libraries.is_empty(), {}, "No library in the search group");
+
+        const int64_t library_count = libraries.size();
+        GroupSearch group{};
+        std::vector<LibrarySearch>& searches = group.searches;
+        searches.assign(library_count, {});
+        for (int64_t i = 0; i < library_count; ++i)
+        {
+            MMAnimationLibrary* library = Object::cast_to<MMAnimationLibrary>(libraries[i]);
+            ERR_FAIL_COND_V_MSG(query.size() != library->nb_dimensions, {}, "Query must the same size as nb_dimensions");
+            searches[i].library = library;
+            searches[i].bias = i < library_biases.size() ? library_biases[i] : 0.0f;
+            // Taken on this thread, the tasks only read it.
+            searches[i].index = library->_get_index();
+        }
+
+        const MMAnimationLibrary::Category_Pred pred(included_category, excluded_category);
+        group.query = query.ptr();
+        group.pred = included_category == std::numeric_limits<int64_t>::max() ? nullptr : &pred;
+        if (library_count >= min_parallel_libraries)
+        {
+            WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+            const int64_t task_id = pool->add_native_group_task(&MMSearchGroup::_search_library, &group, library_count, -1, true, "MMSearchGroup query");
+            pool->wait_for_group_task_completion(task_id);
+        }
+        else
+        {
+            for (int64_t i = 0; i < library_count; ++i)
+            {
+                _search_library(&group, i);
+            }
+        }
+
+        int64_t best = -1;
+        for (int64_t i = 0; i < library_count; ++i)
+        {
+            if (searches[i].row != -1 && (best == -1 || searches[i].cost < searches[best].cost))
+            {
+                best = i;
+            }
+        }
+        Dictionary result{};
+        if (best != -1)
+        {
+            const LibrarySearch& search = searches[best];
+            result["animation"] = search.library->get_row_animation_name(search.row);
+            result["timestamp"] = search.library->db_anim_timestamp[search.row];
+            result["cost"] = search.cost;
+            result["library"] = libraries[best];
+            result["library_index"] = best;
+        }
+        return result;
+    }
+
+protected:
+    static void _bind_methods()
+    {
+        ClassDB::bind_method(D_METHOD("set_libraries", "value"), &MMSearchGroup::set_libraries);
+        ClassDB::bind_method(D_METHOD("get_libraries"), &MMSearchGroup::get_libraries);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::ARRAY, "libraries", PROPERTY_HINT_TYPE_STRING, String::num(Variant::OBJECT) + "/" + String::num(PROPERTY_HINT_RESOURCE_TYPE) + ":MMAnimationLibrary"), "set_libraries", "get_libraries");
+
+        ClassDB::bind_method(D_METHOD("set_library_biases", "value"), &MMSearchGroup::set_library_biases);
+        ClassDB::bind_method(D_METHOD("get_library_biases"), &MMSearchGroup::get_library_biases);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "library_biases"), "set_library_biases", "get_library_biases");
+
+        ClassDB::bind_method(D_METHOD("set_min_parallel_libraries", "value"), &MMSearchGroup::set_min_parallel_libraries);
+        ClassDB::bind_method(D_METHOD("get_min_parallel_libraries"), &MMSearchGroup::get_min_parallel_libraries);
+        godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::INT, "min_parallel_libraries", PROPERTY_HINT_RANGE, "1,16,1,or_greater"), "set_min_parallel_libraries", "get_min_parallel_libraries");
+
+        ClassDB::bind_method(D_METHOD("get_configuration_error"), &MMSearchGroup::get_configuration_error);
+        ClassDB::bind_method(D_METHOD("query_pose", "serialized_query", "include_category", "exclude_category"), &MMSearchGroup::query_pose, DEFVAL(std::numeric_limits<int64_t>::max()), DEFVAL(0));
+    }
+};
@@ -33,6 +33,7 @@
 #include <MotionFeatures/MotionFeatures.hpp>
 #include <KForm.hpp>
 #include <MMAnimationLibrary.hpp>
+#include <SkeletonSampler.hpp>
 #include <algorithm>
 
 using namespace godot;
@@ -71,8 +72,29 @@ struct MFBonesInfo : public MotionFeature {
         return bone_names.size() * 3 * 2;
     }
 
+    // Resolved once in setup_profile/setup_for_animation, so baking a pose doesn't touch any string.
+    SkeletonSampler sampler{};
+    std::vector<std::vector<int32_t>> bones_chain{};
+    // Set by the library while baking. The poses are already evaluated for the whole skeleton.
+    SkeletonSampler* shared_sampler = nullptr;
+
+    virtual void set_skeleton_sampler(SkeletonSampler* p_sampler) override{
+        shared_sampler = p_sampler;
+        if(shared_sampler != nullptr)
+        {
+            for(const auto id : bones_id)
+            {
+                shared_sampler->require_bone(id);
+            }
+        }
+    }
+
     virtual bool setup_for_animation(Ref<Animation> animation)override{
-        return true;
+        if(shared_sampler != nullptr)
+        {
+            return true;
+        }
+        return sampler.setup_for_animation(animation);
     }
 
 
@@ -84,13 +106,18 @@ struct MFBonesInfo : public MotionFeature {
         _skel = skeleton_profile;
         _skel_path = skeleton_path;
         bones_id.clear();
+        bones_chain.clear();
         if(_skel!=nullptr)
         {
+            sampler.setup_profile(_skel_path,_skel);
             for(size_t i = 0; i < bone_names.size();++i)
             {
-                const size_t id = _skel->find_bone(bone_names[i]);
+                const int32_t id = _skel->find_bone(bone_names[i]);
                 if (id >= 0)
+                {
                     bones_id.push_back(id);
+                    bones_chain.push_back(sampler.rootmotion_chain(id));
+                }
                 else
                     ERR_FAIL_V_EDMSG(false,"Missing Bone " + bone_names[i] + " in the SkeletonProfile");
             }
@@ -99,37 +126,81 @@ struct MFBonesInfo : public MotionFeature {
         return false;
     }
 
-    virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time)override{
+    // The velocities scale with the rate, the positions don't. The inertialization dimensions mix both, they're kept.
+    virtual void get_rate_exponents(float* exponents) override{
+        for(int i = 0; i < get_dimension(); ++i)
+        {
+            exponents[i] = !use_inertialization && i % 6 >= 3 ? 1.0f : 0.0f;
+        }
+    }
 
-        PackedFloat32Array result{};
-        kform kbone{};
- 
-        for (size_t index = 0; index < bone_names.size(); ++index)
+    // Each bone takes the values of its mirror, with x negated. A bone whose mirror isn't in bone_names keeps its own values.
+    virtual void get_mirror_mapping(const PackedInt32Array& mirror_bones,int32_t* permutation,float* signs) override{
+        const int stride = use_inertialization ? 3 : 6;
+        for(int64_t index = 0; index < bones_id.size(); ++index)
         {
-            auto path = u::str(_skel_path)+u::str(":")+bone_names[index];
-            kbone = MMAnimationLibrary::sample_bone_rootmotion_kform(animation,time,_skel,path);
-                        
-            // Serialize
-            if (use_inertialization)
+            const int32_t bone = bones_id[index];
+            const int64_t mirror = bone < mirror_bones.size() ? bones_id.find(mirror_bones[bone]) : -1;
+            const int64_t source = mirror != -1 ? mirror : index;
+            for(int c = 0; c < stride; ++c)
             {
-                const auto cost = inertialization_cost_function(kbone.pos, kbone.vel, inertialization_halflife);
-                result.push_back(cost.x);
-                result.push_back(cost.y);
-                result.push_back(cost.z);
-            }
-            else
-            {
-                result.push_back(kbone.pos.x);
-                result.push_back(kbone.pos.y);
-                result.push_back(kbone.pos.z);
-                result.push_back(kbone.vel.x);
-                result.push_back(kbone.vel.y);
-                result.push_back(kbone.vel.z);
+                permutation[index * stride + c] = source * stride + c;
+                signs[index * stride + c] = c % 3 == 0 ? -1.0f : 1.0f;
             }
         }
+    }
 
+    virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time)override{
+        return _bake_pose_with_range(animation,time);
+    }
 
-        return result;
+    virtual bool bake_animation_range(Ref<Animation> animation,const PackedFloat32Array& times,float* out,int64_t stride)override{
+        // Outside of the library bake, the animation asked for may not be the one the sampler was set up for.
+        if(shared_sampler == nullptr && animation.is_valid() && animation != sampler.animation)
+        {
+            ERR_FAIL_COND_V(!sampler.setup_for_animation(animation), false);
+        }
+        SkeletonSampler& s = shared_sampler != nullptr ? *shared_sampler : sampler;
+        ERR_FAIL_COND_V_EDMSG(s.tracks.size() != (size_t)s.get_bone_count(), false, "setup_for_animation must be called before baking");
+        for (int64_t i = 0; i < times.size(); ++i)
+        {
+            const float time = times[i];
+            const int64_t frame = s.find_frame(time);
+            float* row = out + i * stride;
+            kform kbone{};
+
+            for (size_t index = 0; index < bones_chain.size(); ++index)
+            {
+                const int32_t bone = bones_id[index];
+                if(s.is_evaluated(animation,frame,bone))
+                {
+                    kbone = s.rootmotion[frame * s.get_bone_count() + bone];
+                }
+                else
+                {
+                    kbone = s.sample_rootmotion(bones_chain[index],time);
+                }
+
+                // Serialize
+                if (use_inertialization)
+                {
+                    const auto cost = inertialization_cost_function(kbone.pos, kbone.vel, inertialization_halflife);
+                    *row++ = cost.x;
+                    *row++ = cost.y;
+                    *row++ = cost.z;
+                }
+                else
+                {
+                    *row++ = kbone.pos.x;
+                    *row++ = kbone.pos.y;
+                    *row++ = kbone.pos.z;
+                    *row++ = kbone.vel.x;
+                    *row++ = kbone.vel.y;
+                    *row++ = kbone.vel.z;
+                }
+            }
+        }
+        return true;
     }
 
     Vector3 inertialization_cost_function(Vector3 pos, Vector3 vel, float halflife)
@@ -29,6 +29,7 @@
 #include <godot_cpp/classes/box_mesh.hpp>
 
 #include <algorithm>
+#include <vector>
 
 #include <MotionFeatures/MotionFeatures.hpp>
 
@@ -62,14 +63,36 @@ struct MFEvents : public MotionFeature {
 
     GETSET(bool,embed_as_frames);
     GETSET(bool,embed_time_since_last_event);
-    GETSET(godot::PackedStringArray,events_tracks);
-    GETSET(godot::PackedStringArray,events_names);
+
+    // Sorted key times of each event of events_names, for indexed_animation.
+    // Built once per animation, baking and runtime serialization only do binary searches in it.
+    std::vector<std::vector<float>> events_times{};
+    Ref<Animation> indexed_animation{};
+    float indexed_length = 0.0f;
+
+    // Changing the events invalidates the index built for the last animation.
+    godot::PackedStringArray events_tracks{};
+    godot::PackedStringArray get_events_tracks(){return events_tracks;}
+    void set_events_tracks(godot::PackedStringArray value){events_tracks = value; indexed_animation.unref();}
+    godot::PackedStringArray events_names{};
+    godot::PackedStringArray get_events_names(){return events_names;}
+    void set_events_names(godot::PackedStringArray value){events_names = value; indexed_animation.unref();}
 
     static constexpr float delta = 0.016f;
 
-    virtual int get_dimension()override{return events_names.size();}
+    virtual int get_dimension()override{return events_names.size() * (embed_time_since_last_event ? 2 : 1);}
     
-    virtual PackedFloat32Array get_weights()override{ return Array::make(1.0f);}
+    virtual PackedFloat32Array get_weights()override{
+        PackedFloat32Array result{};
+        result.resize(get_dimension());
+        result.fill(1.0f);
+        return result;
+    }
+
+    // Played faster, the events come sooner : every dimension is a time (or a frame count), scaled by 1 / rate.
+    virtual void get_rate_exponents(float* exponents) override{
+        std::fill_n(exponents,get_dimension(),-1.0f);
+    }
 
     virtual bool setup_profile(NodePath skeleton_path,Ref<SkeletonProfile> skel_profile)override{
         // returning false will abort the process.
@@ -82,14 +105,7 @@ struct MFEvents : public MotionFeature {
         // returning false will skip this animation and print a warning
         // feel free to print more details
 
-        bool has_tracks = false;
-        for(auto index_track = 0;index_track < events_names.size(); ++index_track)
-        {
-            const auto track_name = events_tracks[index_track];
-            auto track_id = animation->find_track(track_name,Animation::TrackType::TYPE_METHOD);
-            if(track_id == -1) continue;
-            has_tracks = true;
-        }
+        const bool has_tracks = _build_events_index(animation);
         if(has_tracks == false)
         {
             u::prints("No tracks found the animation",animation->get_path());
@@ -97,45 +113,95 @@ struct MFEvents : public MotionFeature {
 
         return has_tracks;
     }
-    virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time) override {
-        PackedFloat32Array result = {};
-        for(auto event_i = 0;event_i < events_names.size(); ++event_i)
+
+    // Returns false if the animation has none of the events_tracks.
+    bool _build_events_index(Ref<Animation> animation){
+        indexed_animation = animation;
+        indexed_length = animation->get_length();
+        events_times.assign(events_names.size(),{});
+
+        bool has_tracks = false;
+        for(auto index_track = 0;index_track < events_tracks.size(); ++index_track)
         {
-            String event_name = events_names[event_i];
-            float closest_left = 0.0,closest_right = animation->get_length();
-            for(auto index_track = 0;index_track < events_names.size(); ++index_track)
-            {
-                const auto track_name = events_tracks[index_track];
-                auto track_id = animation->find_track(track_name,Animation::TrackType::TYPE_METHOD);
-                if(track_id == -1) continue;
+            const auto track_name = events_tracks[index_track];
+            auto track_id = animation->find_track(track_name,Animation::TrackType::TYPE_METHOD);
+            if(track_id == -1) continue;
+            has_tracks = true;
 
-                for(auto index_key=0;index_key < animation->track_get_key_count(track_id); ++index_key )
+            for(auto index_key=0;index_key < animation->track_get_key_count(track_id); ++index_key )
+            {
+                const StringName method_name = animation->method_track_get_name(track_id,index_key);
+                StringName event_name = method_name;
+                if(method_name == StringName("emit_signal"))
                 {
-                    auto method_name = animation->method_track_get_name(track_id,index_key);
-                    auto method_args = animation->method_track_get_params(track_id,index_key); //0.1
-                    float method_time = (float)animation->track_get_key_time(track_id,index_key); // 0.33
-                    if(method_name == event_name || 
-                     (method_name == String("emit_signal") && method_args[0] == (StringName)event_name ))
-                    {
-                        if                      (time <= method_time )
-                        {
-                            closest_right = std::min(closest_right,method_time);                                                        
-                        }
-                        else if   (method_time < time)
-                        {
-                            closest_left = std::max(closest_left,method_time);
-                        }
-                    }
+                    const Array method_args = animation->method_track_get_params(track_id,index_key);
+                    if(method_args.is_empty()) continue;
+                    event_name = method_args[0];
                 }
+                const int64_t event_i = events_names.find(String(event_name));
+                if(event_i == -1) continue;
+                events_times[event_i].push_back((float)animation->track_get_key_time(track_id,index_key));
             }
-            auto time_until = closest_right - time;
+        }
+        for(auto& times : events_times)
+        {
+            std::sort(times.begin(),times.end());
+        }
+        return has_tracks;
+    }
+
+    // Writes the time until the next event, then the time since the last one if embed_time_since_last_event.
+    void _serialize_time(float time,float* row) const {
+        for(size_t event_i = 0;event_i < events_times.size(); ++event_i)
+        {
+            const auto& times = events_times[event_i];
+            // First event at or after time, the one before it is the last event.
+            const auto next = std::lower_bound(times.begin(),times.end(),time);
+            const float closest_right = next != times.end() ? *next : indexed_length;
+            const float closest_left = next != times.begin() ? *std::prev(next) : 0.0f;
+
+            float time_until = closest_right - time;
+            float time_since = time - closest_left;
             if(embed_as_frames)
             {
                 time_until = sec_to_frame(time_until);
+                time_since = sec_to_frame(time_since);
+            }
+            *row++ = time_until;
+            if(embed_time_since_last_event)
+            {
+                *row++ = time_since;
             }
-            result.append(time_until);
+        }
+    }
 
+    virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time) override {
+        return _bake_pose_with_range(animation,time);
+    }
+
+    virtual bool bake_animation_range(Ref<Animation> animation,const PackedFloat32Array& times,float* out,int64_t stride) override {
+        if(indexed_animation != animation)
+        {
+            _build_events_index(animation);
         }
+        for(int64_t i = 0; i < times.size(); ++i)
+        {
+            _serialize_time(times[i],out + i * stride);
+        }
+        return true;
+    }
+
+    // Events feature of the animation currently playing, for the query.
+    // The index is kept until another animation is given.
+    PackedFloat32Array serialize_animation_time(Ref<Animation> animation,float time){
+        PackedFloat32Array result{};
+        ERR_FAIL_COND_V(animation.is_null(),result);
+        if(indexed_animation != animation)
+        {
+            _build_events_index(animation);
+        }
+        result.resize(get_dimension());
+        _serialize_time(time,result.ptrw());
         return result;
     }
 
@@ -160,6 +226,8 @@ struct MFEvents : public MotionFeature {
         ClassDB::bind_method( D_METHOD("get_embed_time_since_last_event" ), &MFEvents::get_embed_time_since_last_event); 
         godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::BOOL,"embed_time_since_last_event"), "set_embed_time_since_last_event", "get_embed_time_since_last_event");
 
+        ClassDB::bind_method( D_METHOD("serialize_animation_time","animation","time"), &MFEvents::serialize_animation_time);
+
         ClassDB::bind_method( D_METHOD("get_dimension"), &MFEvents::get_dimension);
 
         ClassDB::bind_method( D_METHOD("get_weights"), &MFEvents::get_weights);
@@ -60,6 +60,16 @@ struct MFRootVelocity : public MotionFeature {
         return Array::make(weight,weight,weight);
     }
 
+    virtual void get_rate_exponents(float* exponents) override{
+        std::fill_n(exponents,get_dimension(),1.0f);
+    }
+
+    // The local velocity only changes side.
+    virtual void get_mirror_mapping(const PackedInt32Array& mirror_bones,int32_t* permutation,float* signs) override{
+        MotionFeature::get_mirror_mapping(mirror_bones,permutation,signs);
+        signs[0] = -1.0f;
+    }
+
     virtual bool setup_profile(NodePath skeleton_path,Ref<SkeletonProfile> skeleton_profile) override{
         ERR_FAIL_COND_V_EDMSG(skeleton_path.is_empty(), false,"SkeletonPath is Empty");
         ERR_FAIL_COND_V_EDMSG(skeleton_profile == nullptr, false,"SkeletonProfile is null");
@@ -75,26 +85,36 @@ struct MFRootVelocity : public MotionFeature {
     }
 
     virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time)override{
-        Vector3 pos, prev_pos;
-        if(root_track_pos >= 0)
+        return _bake_pose_with_range(animation,time);
+    }
+
+    virtual bool bake_animation_range(Ref<Animation> animation,const PackedFloat32Array& times,float* out,int64_t stride)override{
+        const Vector3 rest_origin = rest_pose.get_origin();
+        const Quaternion rest_rotation = rest_pose.get_basis().get_rotation_quaternion();
+        for(int64_t i = 0; i < times.size(); ++i)
         {
-            pos = animation->position_track_interpolate(root_track_pos,time + 0.05);
-            prev_pos = animation->position_track_interpolate(root_track_pos,time);
-        } else {
-            pos = rest_pose.get_origin();
-            prev_pos = rest_pose.get_origin();
+            const float time = times[i];
+            Vector3 pos, prev_pos;
+            if(root_track_pos >= 0)
+            {
+                pos = animation->position_track_interpolate(root_track_pos,time + 0.05);
+                prev_pos = animation->position_track_interpolate(root_track_pos,time);
+            } else {
+                pos = rest_origin;
+                prev_pos = rest_origin;
+            }
+
+            Quaternion rotation = root_track_quat >= 0 ? animation->rotation_track_interpolate(root_track_quat,time).normalized() :
+                                                        rest_rotation;
+
+            Vector3 vel = rotation.xform_inv(pos-prev_pos) / 0.05;
+
+            float* row = out + i * stride;
+            row[0] = vel.x;
+            row[1] = vel.y;
+            row[2] = vel.z;
         }
-
-        Quaternion rotation = root_track_quat >= 0 ? animation->rotation_track_interpolate(root_track_quat,time).normalized() :
-                                                    rest_pose.get_basis().get_rotation_quaternion();
-
-        Vector3 vel = rotation.xform_inv(pos-prev_pos) / 0.05;
-
-        PackedFloat32Array result{};
-        result.push_back(vel.x);
-        result.push_back(vel.y);
-        result.push_back(vel.z);
-        return result;
+        return true;
     }
 
     PackedFloat32Array serialize_charbody3d(CharacterBody3D * body)
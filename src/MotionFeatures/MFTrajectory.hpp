@@ -1,5 +1,9 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
 #include <godot_cpp/variant/utility_functions.hpp>
 
 #include <godot_cpp/classes/global_constants.hpp>
@@ -83,11 +87,41 @@ public:
         return past_pos + future_pos + future_rot_angle ;
     }
 
+    // The offsets are sampled at fixed times : played faster, the character goes further in the same time.
+    // Exact for a constant velocity, which is the case of the clips worth playing at another rate.
+    virtual void get_rate_exponents(float* exponents) override
+    {
+        std::fill_n(exponents,get_dimension(),1.0f);
+    }
+
+    // The x of the positions and the heading changes are negated, z is kept.
+    virtual void get_mirror_mapping(const PackedInt32Array& mirror_bones,int32_t* permutation,float* signs) override
+    {
+        MotionFeature::get_mirror_mapping(mirror_bones,permutation,signs);
+        const int64_t pos_dimensions = 2 * (past_time_dt.size() + future_time_dt.size());
+        for (int64_t i = 0; i < pos_dimensions; i += 2)
+        {
+            signs[i] = -1.0f;
+        }
+        for (int64_t i = pos_dimensions; i < get_dimension(); ++i)
+        {
+            signs[i] = -1.0f;
+        }
+    }
+
     int root_tracks[3] = {0,0,0};
     Vector3 start_pos,start_vel,end_pos,end_vel;
     Quaternion start_rot,end_rot, end_ang_vel;
     float start_time = 0.0f, end_time = 0.0f;
 
+    // Root track resampled once per animation at resample_rate, so baking a pose never goes back to the Animation.
+    GETSET(float,resample_rate,60.0f);
+    float root_length = 0.0f;
+    std::vector<Vector3> root_pos{};
+    std::vector<Quaternion> root_rot{};
+    std::vector<float> root_yaw{}; // Heading around Y of root_rot, in radians.
+    Ref<Animation> root_animation{}; // Animation the buffers were resampled from.
+
     virtual bool setup_profile(NodePath skeleton_path,Ref<SkeletonProfile> skeleton_profile) override{
         ERR_FAIL_COND_V_EDMSG(skeleton_path.is_empty(), false,"SkeletonPath is Empty");
         ERR_FAIL_COND_V_EDMSG(skeleton_profile == nullptr, false,"SkeletonProfile is null");
@@ -98,89 +132,138 @@ public:
 
     virtual bool setup_for_animation(Ref<Animation> animation) override
     {
+        ERR_FAIL_COND_V_EDMSG(resample_rate <= 0.0f, false, "resample_rate must be positive");
         start_time = 0.1f;
         end_time = std::floor(animation->get_length() * 10)/10.0f;
         root_tracks[0] = animation->find_track(root_bone_track, Animation::TrackType::TYPE_POSITION_3D);
         root_tracks[1] = animation->find_track(root_bone_track, Animation::TrackType::TYPE_ROTATION_3D);
         root_tracks[2] = animation->find_track(root_bone_track, Animation::TrackType::TYPE_SCALE_3D);
+
+        root_length = animation->get_length();
+        const size_t sample_count = std::max<size_t>((size_t)std::ceil(root_length * resample_rate) + 1, 2);
+        root_pos.resize(sample_count);
+        root_rot.resize(sample_count);
+        root_yaw.resize(sample_count);
+        for (size_t i = 0; i < sample_count; ++i)
+        {
+            const double t = std::min(i / (double)resample_rate, (double)root_length);
+            root_pos[i] = root_tracks[0] != -1 ? animation->position_track_interpolate(root_tracks[0], t) : Vector3();
+            root_rot[i] = root_tracks[1] != -1 ? animation->rotation_track_interpolate(root_tracks[1], t).normalized() : Quaternion();
+            const Vector3 forward = root_rot[i].xform(Vector3(0, 0, 1));
+            root_yaw[i] = std::atan2(forward.x, forward.z);
+        }
+
         {
-            start_pos = animation->position_track_interpolate(root_tracks[0], 0.0);
-            start_rot = animation->rotation_track_interpolate(root_tracks[1], 0.0);
-            start_vel = (animation->position_track_interpolate(root_tracks[0], 0.1) - start_pos) / 0.1;
+            start_pos = sample_root_pos(0.0f);
+            start_rot = sample_root_rot(0.0f);
+            start_vel = (sample_root_pos(0.1f) - start_pos) / 0.1;
         }
         {
-            end_pos = animation->position_track_interpolate(root_tracks[0], end_time);
-            end_rot = animation->rotation_track_interpolate(root_tracks[1], end_time);
-            end_vel = (end_pos - animation->position_track_interpolate(root_tracks[0], end_time - 0.1)) / 0.1;
+            end_pos = sample_root_pos(end_time);
+            end_rot = sample_root_rot(end_time);
+            end_vel = (end_pos - sample_root_pos(end_time - 0.1f)) / 0.1;
 
-            end_ang_vel = animation->rotation_track_interpolate(root_tracks[1], animation->get_length() - delta - 0.1).inverse() * animation->rotation_track_interpolate(root_tracks[1], animation->get_length() - delta);
+            end_ang_vel = sample_root_rot(root_length - delta - 0.1f).inverse() * sample_root_rot(root_length - delta);
         }
+        root_animation = animation;
         return true;
     }
 
+    // Position of the resampled root track, time is clamped to the animation.
+    Vector3 sample_root_pos(float time) const
+    {
+        size_t index; float weight;
+        _resample_index(time, index, weight);
+        return root_pos[index].lerp(root_pos[index + 1], weight);
+    }
+
+    Quaternion sample_root_rot(float time) const
+    {
+        size_t index; float weight;
+        _resample_index(time, index, weight);
+        return root_rot[index].slerp(root_rot[index + 1], weight);
+    }
+
+    float sample_root_yaw(float time) const
+    {
+        size_t index; float weight;
+        _resample_index(time, index, weight);
+        return root_yaw[index] + std::remainder(root_yaw[index + 1] - root_yaw[index], (float)Math_TAU) * weight;
+    }
+
+    void _resample_index(float time, size_t& index, float& weight) const
+    {
+        const float last_frame = root_length * resample_rate;
+        const float frame = std::clamp(time, 0.0f, root_length) * resample_rate;
+        index = std::min((size_t)frame, root_pos.size() - 2);
+        // The last sample is clamped to the animation length, so the last interval may be shorter.
+        const float span = std::min(index + 1.0f, last_frame) - index;
+        weight = span > 0.0f ? std::clamp((frame - index) / span, 0.0f, 1.0f) : 0.0f;
+    }
+
     virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time)override 
     {
-        PackedFloat32Array result{};
-        Vector3 curr_pos = animation->position_track_interpolate(root_tracks[0],time);
-        Quaternion curr_rot = animation->rotation_track_interpolate(root_tracks[1],time);
+        return _bake_pose_with_range(animation,time);
+    }
 
-        for (size_t index = 0; index < past_time_dt.size(); ++index)
+    virtual bool bake_animation_range(Ref<Animation> animation,const PackedFloat32Array& times,float* out,int64_t stride)override
+    {
+        // The library sets up each animation before baking it, a script may ask for another one.
+        if (animation.is_valid() && animation != root_animation)
         {
-            const float t = time - abs(past_time_dt[index]);
-            Vector3 pos{};
-            Quaternion rot{};
-            if (t >= 0.0f)
-            { // The offset can be accessed through the anim data
-                pos = animation->position_track_interpolate(root_tracks[0], t) - curr_pos;
-                rot = animation->rotation_track_interpolate(root_tracks[1], t);
-                pos = curr_rot.xform_inv(pos);
-            }
-            else
-            { // The offset must be calculated using the starting velocity and extrapoling
-                pos = start_pos + (start_vel * t) - curr_pos;
-                pos = curr_rot.xform_inv(pos);
-            }
-            result.push_back(pos.x);
-            result.push_back(pos.z);
+            ERR_FAIL_COND_V(!setup_for_animation(animation), false);
         }
-        for (size_t index = 0; index < future_time_dt.size(); ++index)
+        ERR_FAIL_COND_V_EDMSG(root_pos.size() < 2, false, "setup_for_animation must be called before baking");
+        const float end_yaw = sample_root_yaw(root_length - delta);
+        for (int64_t i = 0; i < times.size(); ++i)
         {
-            const float t = time + abs(future_time_dt[index]);
-            Vector3 pos{};
-            Quaternion rot{};
-            if (t <= end_time)
-            { // The offset can be accessed through the anim data
-                pos = animation->position_track_interpolate(root_tracks[0], t) - curr_pos;
-                rot = animation->rotation_track_interpolate(root_tracks[1], t);
+            const float time = times[i];
+            float* row = out + i * stride;
+            const Vector3 curr_pos = sample_root_pos(time);
+            const Quaternion curr_rot = sample_root_rot(time);
+            const float curr_yaw = sample_root_yaw(time);
+
+            for (size_t index = 0; index < past_time_dt.size(); ++index)
+            {
+                const float t = time - abs(past_time_dt[index]);
+                Vector3 pos{};
+                if (t >= 0.0f)
+                { // The offset can be accessed through the anim data
+                    pos = sample_root_pos(t) - curr_pos;
+                }
+                else
+                { // The offset must be calculated using the starting velocity and extrapoling
+                    pos = start_pos + (start_vel * t) - curr_pos;
+                }
                 pos = curr_rot.xform_inv(pos);
+                *row++ = pos.x;
+                *row++ = pos.z;
             }
-            else
-            { // The offset must be calculated using the end velocity and extrapoling
-                pos = end_pos + end_vel * (t - end_time) - curr_pos;
+            for (size_t index = 0; index < future_time_dt.size(); ++index)
+            {
+                const float t = time + abs(future_time_dt[index]);
+                Vector3 pos{};
+                if (t <= end_time)
+                { // The offset can be accessed through the anim data
+                    pos = sample_root_pos(t) - curr_pos;
+                }
+                else
+                { // The offset must be calculated using the end velocity and extrapoling
+                    pos = end_pos + end_vel * (t - end_time) - curr_pos;
+                }
                 pos = curr_rot.xform_inv(pos);
+                *row++ = pos.x;
+                *row++ = pos.z;
             }
-
-
-            result.push_back(pos.x);
-            result.push_back(pos.z);
-        }
-        for (size_t index = 0; index < future_time_dt.size(); ++index)
-        {
-            const float t = time + abs(future_time_dt[index]);
-            Vector3 pos{};
-            Quaternion rot{};
-            if (t <= end_time)
-            { // The offset can be accessed through the anim data
-                rot = animation->rotation_track_interpolate(root_tracks[1], t) * curr_rot.inverse();
-            }
-            else
-            { // The offset must be calculated using the end velocity and extrapoling
-                rot = animation->rotation_track_interpolate(root_tracks[1], animation->get_length() - delta) * curr_rot.inverse();
+            for (size_t index = 0; index < future_time_dt.size(); ++index)
+            {
+                const float t = time + abs(future_time_dt[index]);
+                // Past the end, the heading stays the one of the last frame.
+                const float yaw = t <= end_time ? sample_root_yaw(t) : end_yaw;
+                *row++ = std::remainder(yaw - curr_yaw, (float)Math_TAU);
             }
-            
-            result.push_back(rot.get_euler_xyz().y);
         }
-        return result;
+        return true;
     }
 
     GETSET(PackedVector3Array,history_pos)
@@ -221,6 +304,7 @@ public:
             m_default.push_back(0.2);m_default.push_back(0.4);
             ClassDB::bind_method( D_METHOD("set_past_time_dt","value"), &MFTrajectory::set_past_time_dt,(m_default)); ClassDB::bind_method( D_METHOD("get_past_time_dt"), &MFTrajectory::get_past_time_dt); godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY,"past_time_dt"), "set_past_time_dt", "get_past_time_dt");
             ClassDB::bind_method( D_METHOD("set_future_time_dt","value"), &MFTrajectory::set_future_time_dt ); ClassDB::bind_method( D_METHOD("get_future_time_dt"), &MFTrajectory::get_future_time_dt); godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::PACKED_FLOAT32_ARRAY,"future_time_dt"), "set_future_time_dt", "get_future_time_dt");
+            ClassDB::bind_method( D_METHOD("set_resample_rate","value"), &MFTrajectory::set_resample_rate ); ClassDB::bind_method( D_METHOD("get_resample_rate"), &MFTrajectory::get_resample_rate); godot::ClassDB::add_property(get_class_static(), PropertyInfo(Variant::FLOAT,"resample_rate",PROPERTY_HINT_RANGE,"1,240,1,or_greater"), "set_resample_rate", "get_resample_rate");
             
             ClassDB::bind_method(D_METHOD("set_debug_color_history", "value"), &MFTrajectory::set_debug_color_history);
             ClassDB::bind_method(D_METHOD("get_debug_color_history"), &MFTrajectory::get_debug_color_history);
@@ -28,6 +28,10 @@
 #include <godot_cpp/classes/standard_material3d.hpp>
 #include <godot_cpp/classes/box_mesh.hpp>
 
+#include <algorithm>
+
+
+struct SkeletonSampler;
 
 struct MotionFeature : public Resource {
     GDCLASS(MotionFeature,Resource)
@@ -53,6 +57,86 @@ struct MotionFeature : public Resource {
     }
     virtual PackedFloat32Array bake_animation_pose(Ref<Animation> animation,float time){return {};}
 
+    // Bake all the poses of an animation at once, the row of times[i] is written at out + i * stride.
+    // C++ features override it to write straight into the library data. The default goes through bake_animation_pose,
+    // using the script method when there is one, so features defined in script keep working.
+    // Returns false if a pose couldn't be baked.
+    virtual bool bake_animation_range(Ref<Animation> animation,const PackedFloat32Array& times,float* out,int64_t stride){
+        const bool scripted = get_script().get_type() != Variant::NIL;
+        const int dimension = get_dimension();
+        for(int64_t i = 0; i < times.size(); ++i)
+        {
+            const PackedFloat32Array pose = scripted ? (PackedFloat32Array)call("bake_animation_pose",animation,times[i]) : bake_animation_pose(animation,times[i]);
+            ERR_FAIL_COND_V_MSG(pose.size() != dimension,false,"bake_animation_pose didn't return a array of the correct size");
+            std::copy(pose.ptr(),pose.ptr() + dimension,out + i * stride);
+        }
+        return true;
+    }
+
+    // bake_animation_pose of the features implementing bake_animation_range.
+    PackedFloat32Array _bake_pose_with_range(Ref<Animation> animation,float time){
+        PackedFloat32Array times{};
+        times.push_back(time);
+        PackedFloat32Array result{};
+        result.resize(get_dimension());
+        if(!bake_animation_range(animation,times,result.ptrw(),get_dimension()))
+        {
+            return {};
+        }
+        return result;
+    }
+
+    // Whole skeleton poses evaluated once per time by the library while baking, nullptr otherwise.
+    // Features needing bones should require them here and read the sampler buffers instead of sampling on their own.
+    virtual void set_skeleton_sampler(SkeletonSampler* sampler){}
+
+    // Mirror of a row across the character YZ plane, left and right swapped : mirrored[i] = signs[i] * row[permutation[i]].
+    // mirror_bones maps each bone of the profile to its mirror (itself for the bones without a side).
+    // The indices are local to the feature. The default is for the features without a side, the row doesn't change.
+    virtual void get_mirror_mapping(const PackedInt32Array& mirror_bones,int32_t* permutation,float* signs){
+        for(int i = 0; i < get_dimension(); ++i)
+        {
+            permutation[i] = i;
+            signs[i] = 1.0f;
+        }
+    }
+
+    // How each dimension changes when the animation is played at another rate : it's multiplied by rate^exponents[i].
+    // 1 for the velocities and the offsets sampled at a fixed time step, 0 for the dimensions that don't change (default).
+    virtual void get_rate_exponents(float* exponents){
+        std::fill_n(exponents,get_dimension(),0.0f);
+    }
+
+    // Name of the bone on the other side : Left/Right, left/right and the .L/.R, _L/_R suffixes are swapped.
+    // Returns the name unchanged for the bones without a side.
+    static String mirror_bone_name(const String& name){
+        static const char* sides[][2] = {{"Left","Right"},{"left","right"},{"LEFT","RIGHT"}};
+        for(const auto& side : sides)
+        {
+            if(name.find(side[0]) != -1)
+            {
+                return name.replace(side[0],side[1]);
+            }
+            if(name.find(side[1]) != -1)
+            {
+                return name.replace(side[1],side[0]);
+            }
+        }
+        static const char* suffixes[][2] = {{".L",".R"},{"_L","_R"},{".l",".r"},{"_l","_r"}};
+        for(const auto& suffix : suffixes)
+        {
+            if(name.ends_with(suffix[0]))
+            {
+                return name.substr(0,name.length() - 2) + suffix[1];
+            }
+            if(name.ends_with(suffix[1]))
+            {
+                return name.substr(0,name.length() - 2) + suffix[0];
+            }
+        }
+        return name;
+    }
+
     virtual void debug_pose_gizmo(Ref<EditorNode3DGizmo> gizmo, const PackedFloat32Array data,godot::Transform3D tr = godot::Transform3D{}){return;}
 
     
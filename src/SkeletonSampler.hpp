@@ -0,0 +1,227 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <godot_cpp/classes/animation.hpp>
+#include <godot_cpp/classes/skeleton_profile.hpp>
+#include <godot_cpp/variant/node_path.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <KForm.hpp>
+
+using namespace godot;
+
+/// @brief Sampling context of a SkeletonProfile against an animation.
+/// setup_profile() resolves the bones hierarchy once, setup_for_animation() resolves the tracks once per animation.
+/// After that, sampling a bone only works with integer indices : no NodePath, no find_bone, no find_track.
+/// evaluate() samples the required bones once per time and composes them in parent order,
+/// so every feature reading the same (animation,time) share the same work.
+struct SkeletonSampler
+{
+    // Profile data. Indices are the SkeletonProfile bone indices.
+    NodePath skeleton_path{};
+    int32_t root_bone = -1;
+    std::vector<int32_t> parents{};       // Parent of each bone, -1 if none.
+    std::vector<kform> reference_pose{};  // Used when the animation doesn't have a track.
+    std::vector<NodePath> bone_paths{};   // skeleton_path:bone_name
+
+    // Animation data.
+    Ref<Animation> animation{};
+    std::vector<kform_tracks> tracks{};
+
+    // Bones evaluated by evaluate(), sorted so that a parent is always before its children.
+    std::vector<bool> required{};
+    std::vector<int32_t> order{};
+
+    // Evaluated poses. The buffers are laid out [frame][bone].
+    std::vector<double> frame_times{};
+    kforms local{0}, model{0}, rootmotion{0}, global{0};
+
+    int32_t get_bone_count() const { return (int32_t)parents.size(); }
+
+    bool setup_profile(NodePath p_skeleton_path, Ref<SkeletonProfile> profile)
+    {
+        ERR_FAIL_COND_V(profile == nullptr, false);
+        skeleton_path = p_skeleton_path;
+        const int32_t bone_count = profile->get_bone_size();
+        parents.resize(bone_count);
+        reference_pose.resize(bone_count);
+        bone_paths.resize(bone_count);
+        for (int32_t bone = 0; bone < bone_count; ++bone)
+        {
+            const StringName parent_name = profile->get_bone_parent(bone);
+            parents[bone] = parent_name.is_empty() ? -1 : profile->find_bone(parent_name);
+            reference_pose[bone] = kform{profile->get_reference_pose(bone)};
+            bone_paths[bone] = NodePath(UtilityFunctions::str(skeleton_path) + ":" + String(profile->get_bone_name(bone)));
+        }
+        root_bone = profile->get_root_bone().is_empty() ? -1 : profile->find_bone(profile->get_root_bone());
+        animation.unref();
+        tracks.clear();
+        required.assign(bone_count, false);
+        order.clear();
+        frame_times.clear();
+        if (root_bone != -1)
+        {
+            require_bone(root_bone);
+        }
+        return true;
+    }
+
+    // Mark the bone and all its parents to be evaluated.
+    void require_bone(int32_t bone)
+    {
+        ERR_FAIL_INDEX(bone, get_bone_count());
+        bool changed = false;
+        for (; bone != -1 && !required[bone]; bone = parents[bone])
+        {
+            required[bone] = true;
+            changed = true;
+        }
+        if (changed)
+        {
+            _update_order();
+        }
+    }
+
+    void require_all_bones()
+    {
+        for (int32_t bone = 0; bone < get_bone_count(); ++bone)
+        {
+            require_bone(bone);
+        }
+    }
+
+    void _update_order()
+    {
+        // Depth sort. The profile is small, a parent has always a smaller depth than its children.
+        std::vector<int32_t> depth(parents.size(), 0);
+        order.clear();
+        for (int32_t bone = 0; bone < get_bone_count(); ++bone)
+        {
+            for (int32_t p = parents[bone]; p != -1; p = parents[p])
+            {
+                ++depth[bone];
+            }
+            if (required[bone])
+            {
+                order.push_back(bone);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&depth](int32_t a, int32_t b)
+                         { return depth[a] < depth[b]; });
+        frame_times.clear();
+    }
+
+    bool setup_for_animation(const Ref<Animation>& p_animation)
+    {
+        ERR_FAIL_COND_V(p_animation.is_null(), false);
+        animation = p_animation;
+        tracks.resize(bone_paths.size());
+        for (size_t bone = 0; bone < bone_paths.size(); ++bone)
+        {
+            tracks[bone] = kform_tracks{animation, bone_paths[bone]};
+        }
+        frame_times.clear();
+        return true;
+    }
+
+    // Sample every required bone once per time, then compose all the spaces in parent order.
+    // Spaces follows MMAnimationLibrary::sample_bone_*_info :
+    // Model stops at the root bone, RootMotion is Model under the root bone velocities, Global is the full chain.
+    void evaluate(const double *times, int64_t count)
+    {
+        ERR_FAIL_COND(animation.is_null());
+        const size_t bone_count = parents.size();
+        frame_times.assign(times, times + count);
+        local.resize(bone_count * count);
+        model.resize(bone_count * count);
+        rootmotion.resize(bone_count * count);
+        global.resize(bone_count * count);
+
+        for (int64_t frame = 0; frame < count; ++frame)
+        {
+            const size_t offset = frame * bone_count;
+            kform root_space{};
+            for (const int32_t bone : order)
+            {
+                const kform l = sample_local(bone, times[frame]);
+                const int32_t parent = parents[bone];
+                local.set(offset + bone, l);
+                global.set(offset + bone, parent == -1 ? l : global[offset + parent] * l);
+                model.set(offset + bone, (parent == -1 || parent == root_bone) ? l : model[offset + parent] * l);
+                if (bone == root_bone)
+                {
+                    root_space.vel = l.rot.xform_inv(l.vel);
+                    root_space.ang = l.rot.xform_inv(l.ang);
+                    root_space.scl = l.scl;
+                    root_space.svl = l.svl;
+                }
+            }
+            // root_space needs the root bone sampled, so RootMotion is composed in a second pass.
+            for (const int32_t bone : order)
+            {
+                rootmotion.set(offset + bone, root_space * model[offset + bone]);
+            }
+        }
+    }
+
+    void evaluate(double time)
+    {
+        evaluate(&time, 1);
+    }
+
+    // Frame of an evaluated time, -1 if it wasn't evaluated for the current animation.
+    // The evaluated times must be in ascending order.
+    int64_t find_frame(double time) const
+    {
+        constexpr double epsilon = 1e-5;
+        const auto it = std::lower_bound(frame_times.begin(), frame_times.end(), time - epsilon);
+        if (it == frame_times.end() || *it > time + epsilon)
+        {
+            return -1;
+        }
+        return std::distance(frame_times.begin(), it);
+    }
+
+    bool is_evaluated(const Ref<Animation>& p_animation, int64_t frame, int32_t bone) const
+    {
+        return animation == p_animation && frame >= 0 && frame < (int64_t)frame_times.size() && bone >= 0 && bone < get_bone_count() && required[bone];
+    }
+
+    // Chain used by the RootMotion space : the bone first, then its parents up to the root bone (excluded).
+    std::vector<int32_t> rootmotion_chain(int32_t bone) const
+    {
+        std::vector<int32_t> chain{};
+        do
+        {
+            chain.push_back(bone);
+            bone = parents[bone];
+        } while (bone != -1 && bone != root_bone);
+        return chain;
+    }
+
+    kform sample_local(int32_t bone, double time) const
+    {
+        return kform{reference_pose[bone], animation, tracks[bone], time};
+    }
+
+    // Same result as MMAnimationLibrary::sample_bone_rootmotion_kform, using a chain from rootmotion_chain().
+    kform sample_rootmotion(const std::vector<int32_t> &chain, double time) const
+    {
+        kform result{};
+        if (root_bone != -1)
+        {
+            const kform root = sample_local(root_bone, time);
+            result.vel = root.rot.xform_inv(root.vel);
+            result.ang = root.rot.xform_inv(root.ang);
+            result.scl = root.scl;
+            result.svl = root.svl;
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            result = result * sample_local(*it, time);
+        }
+        return result;
+    }
+};
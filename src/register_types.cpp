@@ -16,6 +16,7 @@
 
 #include <MMAnimationLibrary.hpp>
 #include <MMAnimationPlayer.hpp>
+#include <MMSearchGroup.hpp>
 #include <PostProcessAnimation/PPInertialization3D.hpp>
 #include <PostProcessAnimation/PPIKLookAt3D.hpp>
 #include <PostProcessAnimation/PPIKTwoBone3D.hpp>
@@ -49,7 +50,9 @@ void gdextension_MM_initialize(ModuleInitializationLevel p_level)
 		ClassDB::register_class<MFEvents>();
 
 		ClassDB::register_class<MMAnimationPlayer>();
+		ClassDB::register_class<MMQueryResult>();
 		ClassDB::register_class<MMAnimationLibrary>();
+		ClassDB::register_class<MMSearchGroup>();
 
 		ClassDB::register_class<PPInertialization3D>();
 		ClassDB::register_class<PPIKLookAt3D>();
@@ -13,6 +13,15 @@
 // be done to the current state of the object. This include the constructor
 // -- Added logic to have a custom_weight for a single query. Good for paralellism
 // and let user have custom query.
+// -- The distance measure is passed down to every recursive call.
+// -- The search predicate is passed along the search instead of being stored in the
+// tree, so a tree can be queried from several threads at once.
+// -- The maximum distance prunes the subtrees with the maximum of the coordinate
+// distances instead of their sum.
+// -- The distances don't own their weights, so a query with custom weights builds
+// its distance on the stack instead of allocating and copying the weights.
+// -- Every node has an additive bias. Each subtree keeps its smallest bias, the
+// knn search prunes with the bounding box distance plus that lower bound.
 
 #include "kdtree.hpp"
 #include <math.h>
@@ -43,6 +52,7 @@ class kdtree_node {
  public:
   kdtree_node() {
     dataindex = cutdim = 0;
+    minbias = 0.0f;
     loson = hison = (kdtree_node*)NULL;
   }
   ~kdtree_node() {
@@ -60,6 +70,8 @@ class kdtree_node {
   kdtree_node *loson, *hison;
   // bounding rectangle of this node's subtree
   CoordPoint lobound, upbound;
+  // smallest bias of this node's subtree
+  float minbias;
 };
 
 //--------------------------------------------------------------
@@ -71,28 +83,22 @@ class DistanceMeasure {
   virtual ~DistanceMeasure() {}
   virtual float distance(const CoordPoint& p, const CoordPoint& q) = 0;
   virtual float coordinate_distance(float x, float y, size_t dim) = 0;
+  // how coordinate distances add up to a distance
+  virtual float accumulate(float dist, float coordinate_dist) { return dist + coordinate_dist; }
 };
 // Maximum distance (Linfinite norm)
 class DistanceL0 : virtual public DistanceMeasure {
-  WeightVector* w;
+  const float* w;
 
  public:
-  DistanceL0(const WeightVector* weights = NULL) {
-    if (weights)
-      w = new WeightVector(*weights);
-    else
-      w = (WeightVector*)NULL;
-  }
-  ~DistanceL0() {
-    if (w) delete w;
-  }
+  DistanceL0(const float* weights = NULL) : w(weights) {}
   float distance(const CoordPoint& p, const CoordPoint& q) {
     size_t i;
     float dist, test;
     if (w) {
-      dist = (*w)[0] * fabs(p[0] - q[0]);
+      dist = w[0] * fabs(p[0] - q[0]);
       for (i = 1; i < p.size(); i++) {
-        test = (*w)[i] * fabs(p[i] - q[i]);
+        test = w[i] * fabs(p[i] - q[i]);
         if (test > dist) dist = test;
       }
     } else {
@@ -106,30 +112,25 @@ class DistanceL0 : virtual public DistanceMeasure {
   }
   float coordinate_distance(float x, float y, size_t dim) {
     if (w)
-      return (*w)[dim] * fabs(x - y);
+      return w[dim] * fabs(x - y);
     else
       return fabs(x - y);
   }
+  float accumulate(float dist, float coordinate_dist) {
+    return coordinate_dist > dist ? coordinate_dist : dist;
+  }
 };
 // Manhatten distance (L1 norm)
 class DistanceL1 : virtual public DistanceMeasure {
-  WeightVector* w;
+  const float* w;
 
  public:
-  DistanceL1(const WeightVector* weights = NULL) {
-    if (weights)
-      w = new WeightVector(*weights);
-    else
-      w = (WeightVector*)NULL;
-  }
-  ~DistanceL1() {
-    if (w) delete w;
-  }
+  DistanceL1(const float* weights = NULL) : w(weights) {}
   float distance(const CoordPoint& p, const CoordPoint& q) {
     size_t i;
     float dist = 0.0;
     if (w) {
-      for (i = 0; i < p.size(); i++) dist += (*w)[i] * fabs(p[i] - q[i]);
+      for (i = 0; i < p.size(); i++) dist += w[i] * fabs(p[i] - q[i]);
     } else {
       for (i = 0; i < p.size(); i++) dist += fabs(p[i] - q[i]);
     }
@@ -137,31 +138,23 @@ class DistanceL1 : virtual public DistanceMeasure {
   }
   float coordinate_distance(float x, float y, size_t dim) {
     if (w)
-      return (*w)[dim] * fabs(x - y);
+      return w[dim] * fabs(x - y);
     else
       return fabs(x - y);
   }
 };
 // Euklidean distance (L2 norm) (squared)
 class DistanceL2 : virtual public DistanceMeasure {
-  WeightVector* w;
+  const float* w;
 
  public:
-  DistanceL2(const WeightVector* weights = NULL) {
-    if (weights)
-      w = new WeightVector(*weights);
-    else
-      w = (WeightVector*)NULL;
-  }
-  ~DistanceL2() {
-    if (w) delete w;
-  }
+  DistanceL2(const float* weights = NULL) : w(weights) {}
   float distance(const CoordPoint& p, const CoordPoint& q) {
     size_t i;
     float dist = 0.0;
     if (w) {
       for (i = 0; i < p.size(); i++)
-        dist += (*w)[i] * (p[i] - q[i]) * (p[i] - q[i]);
+        dist += w[i] * (p[i] - q[i]) * (p[i] - q[i]);
     } else {
       for (i = 0; i < p.size(); i++) dist += (p[i] - q[i]) * (p[i] - q[i]);
     }
@@ -169,7 +162,7 @@ class DistanceL2 : virtual public DistanceMeasure {
   }
   float coordinate_distance(float x, float y, size_t dim) {
     if (w)
-      return (*w)[dim] * (x - y) * (x - y);
+      return w[dim] * (x - y) * (x - y);
     else
       return (x - y) * (x - y);
   }
@@ -220,12 +213,18 @@ void KdTree::set_distance(int distance_type,
                           const WeightVector* weights /*=NULL*/) {
   if (default_distance) delete default_distance;
   this->distance_type = distance_type;
+  // the default distance points to the tree's copy of the weights
+  if (weights)
+    this->weights = *weights;
+  else
+    this->weights.clear();
+  const float* w = weights ? this->weights.data() : NULL;
   if (distance_type == 0) {
-    default_distance = (DistanceMeasure*)new DistanceL0(weights);
+    default_distance = (DistanceMeasure*)new DistanceL0(w);
   } else if (distance_type == 1) {
-    default_distance = (DistanceMeasure*)new DistanceL1(weights);
+    default_distance = (DistanceMeasure*)new DistanceL1(w);
   } else {
-    default_distance = (DistanceMeasure*)new DistanceL2(weights);
+    default_distance = (DistanceMeasure*)new DistanceL2(w);
   }
 }
 
@@ -244,6 +243,7 @@ kdtree_node* KdTree::build_tree(size_t depth, size_t a, size_t b) {
   if (b - a <= 1) {
     node->dataindex = a;
     node->point = allnodes[a].point;
+    node->minbias = allnodes[a].bias;
   } else {
     m = (a + b) / 2;
     std::nth_element(allnodes.begin() + a, allnodes.begin() + m,
@@ -263,6 +263,9 @@ kdtree_node* KdTree::build_tree(size_t depth, size_t a, size_t b) {
       node->hison = build_tree(depth + 1, m + 1, b);
       lobound[node->cutdim] = temp;
     }
+    node->minbias = allnodes[m].bias;
+    if (node->loson) node->minbias = std::min(node->minbias, node->loson->minbias);
+    if (node->hison) node->minbias = std::min(node->minbias, node->hison->minbias);
   }
   return node;
 }
@@ -279,10 +282,9 @@ kdtree_node* KdTree::build_tree(size_t depth, size_t a, size_t b) {
 void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
                                  KdNodeVector* result,
                                  KdNodePredicate* pred /*=NULL*/,
-                                 const WeightVector * custom_weight /*NULL*/) {
+                                 const float* custom_weight /*NULL*/) {
   size_t i;
   KdNode temp;
-  searchpredicate = pred;
 
   result->clear();
   if (k < 1) return;
@@ -293,15 +295,21 @@ void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
     //     "kdtree");
     return;
   }
+  // the custom weights are only pointed to, nothing is allocated for them.
+  // The pruning goes through the same distance, so it stays exact for any
+  // non negative weights, whatever the weights of the tree.
+  DistanceL0 custom_l0(custom_weight);
+  DistanceL1 custom_l1(custom_weight);
+  DistanceL2 custom_l2(custom_weight);
   DistanceMeasure * custom_distance = default_distance;
   if (custom_weight != nullptr)
   {
     if (distance_type == 0) {
-      custom_distance = (DistanceMeasure*)new DistanceL0(custom_weight);
+      custom_distance = &custom_l0;
     } else if (distance_type == 1) {
-      custom_distance = (DistanceMeasure*)new DistanceL1(custom_weight);
+      custom_distance = &custom_l1;
     } else {
-      custom_distance = (DistanceMeasure*)new DistanceL2(custom_weight);
+      custom_distance = &custom_l2;
     }
   }
 
@@ -313,12 +321,12 @@ void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
     // when more neighbors asked than nodes in tree, return everything
     k = allnodes.size();
     for (i = 0; i < k; i++) {
-      if (!(searchpredicate && !(*searchpredicate)(allnodes[i])))
+      if (!(pred && !(*pred)(allnodes[i])))
         neighborheap->push(
-            nn4heap(i, custom_distance->distance(allnodes[i].point, point)));
+            nn4heap(i, custom_distance->distance(allnodes[i].point, point) + allnodes[i].bias));
     }
   } else {
-    neighbor_search(point, root, k, neighborheap,custom_distance);
+    neighbor_search(point, root, k, neighborheap,custom_distance,pred);
   }
 
   // copy over result sorted by distance
@@ -336,10 +344,6 @@ void KdTree::k_nearest_neighbors(const CoordPoint& point, size_t k,
     (*result)[k - 1 - i] = temp;
   }
   delete neighborheap;
-  if(custom_weight != nullptr && custom_distance != nullptr && default_distance != custom_distance)
-  {
-    delete custom_distance; // ONLY if not the default; 
-  }
 }
 
 //--------------------------------------------------------------
@@ -386,11 +390,12 @@ void KdTree::range_nearest_neighbors(const CoordPoint& point, float r,
 // returns "true" when no nearer neighbor elsewhere possible
 //--------------------------------------------------------------
 bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
-                             size_t k, SearchQueue* neighborheap, DistanceMeasure * distance) {
+                             size_t k, SearchQueue* neighborheap, DistanceMeasure * distance,
+                             const KdNodePredicate* pred) {
   float curdist, dist;
 
-  curdist = distance->distance(point, node->point);
-  if (!(searchpredicate && !(*searchpredicate)(allnodes[node->dataindex]))) {
+  curdist = distance->distance(point, node->point) + allnodes[node->dataindex].bias;
+  if (!(pred && !(*pred)(allnodes[node->dataindex]))) {
     if (neighborheap->size() < k) {
       neighborheap->push(nn4heap(node->dataindex, curdist));
     } else if (curdist < neighborheap->top().distance) {
@@ -401,10 +406,10 @@ bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
   // first search on side closer to point
   if (point[node->cutdim] < node->point[node->cutdim]) {
     if (node->loson)
-      if (neighbor_search(point, node->loson, k, neighborheap,distance)) return true;
+      if (neighbor_search(point, node->loson, k, neighborheap,distance,pred)) return true;
   } else {
     if (node->hison)
-      if (neighbor_search(point, node->hison, k, neighborheap,distance)) return true;
+      if (neighbor_search(point, node->hison, k, neighborheap,distance,pred)) return true;
   }
   // second search on farther side, if necessary
   if (neighborheap->size() < k) {
@@ -412,16 +417,18 @@ bool KdTree::neighbor_search(const CoordPoint& point, kdtree_node* node,
   } else {
     dist = neighborheap->top().distance;
   }
+  // a subtree can't be closer than its bounds plus its smallest bias
   if (point[node->cutdim] < node->point[node->cutdim]) {
-    if (node->hison && bounds_overlap_ball(point, dist, node->hison))
-      if (neighbor_search(point, node->hison, k, neighborheap,distance)) return true;
+    if (node->hison && bounds_overlap_ball(point, dist - node->hison->minbias, node->hison, distance))
+      if (neighbor_search(point, node->hison, k, neighborheap,distance,pred)) return true;
   } else {
-    if (node->loson && bounds_overlap_ball(point, dist, node->loson))
-      if (neighbor_search(point, node->loson, k, neighborheap,distance)) return true;
+    if (node->loson && bounds_overlap_ball(point, dist - node->loson->minbias, node->loson, distance))
+      if (neighbor_search(point, node->loson, k, neighborheap,distance,pred)) return true;
   }
 
   if (neighborheap->size() == k) dist = neighborheap->top().distance;
-  return ball_within_bounds(point, dist, node);
+  // the nodes outside of this subtree are at least at the smallest bias of the tree
+  return ball_within_bounds(point, dist - root->minbias, node, distance);
 }
 
 //--------------------------------------------------------------
@@ -434,11 +441,11 @@ void KdTree::range_search(const CoordPoint& point, kdtree_node* node,
   if (curdist <= r) {
     range_result->push_back(node->dataindex);
   }
-  if (node->loson != NULL && this->bounds_overlap_ball(point, r, node->loson)) {
-    range_search(point, node->loson, r, range_result);
+  if (node->loson != NULL && this->bounds_overlap_ball(point, r, node->loson, distance)) {
+    range_search(point, node->loson, r, range_result, distance);
   }
-  if (node->hison != NULL && this->bounds_overlap_ball(point, r, node->hison)) {
-    range_search(point, node->hison, r, range_result);
+  if (node->hison != NULL && this->bounds_overlap_ball(point, r, node->hison, distance)) {
+    range_search(point, node->hison, r, range_result, distance);
   }
 }
 
@@ -450,10 +457,10 @@ bool KdTree::bounds_overlap_ball(const CoordPoint& point, float dist,
   size_t i;
   for (i = 0; i < dimension; i++) {
     if (point[i] < node->lobound[i]) {  // lower than low boundary
-      distsum += distance->coordinate_distance(point[i], node->lobound[i], i);
+      distsum = distance->accumulate(distsum, distance->coordinate_distance(point[i], node->lobound[i], i));
       if (distsum > dist) return false;
     } else if (point[i] > node->upbound[i]) {  // higher than high boundary
-      distsum += distance->coordinate_distance(point[i], node->upbound[i], i);
+      distsum = distance->accumulate(distsum, distance->coordinate_distance(point[i], node->upbound[i], i));
       if (distsum > dist) return false;
     }
   }
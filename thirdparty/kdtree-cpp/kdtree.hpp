@@ -17,6 +17,10 @@
 // be done to the current state of the object. This include the constructor
 // -- Added logic to have a custom_weight for a single query. Good for paralellism
 // and let user have custom query.
+// -- The search predicate is passed along the search instead of being stored in the
+// tree, so a tree can be queried from several threads at once.
+// -- The custom_weight of a query is used in place, without copy (nb of dimensions values).
+// -- Every node has an additive bias, included in the k nearest neighbors distance.
 
 #include <cstdlib>
 #include <queue>
@@ -32,12 +36,14 @@ struct KdNode {
   CoordPoint point;
   void* data;
   int index;
-  KdNode(const CoordPoint& p, void* d = NULL, int i = -1) {
+  float bias;  // added to the distance of this node in the knn search
+  KdNode(const CoordPoint& p, void* d = NULL, int i = -1, float b = 0.0f) {
     point = p;
     data = d;
     index = i;
+    bias = b;
   }
-  KdNode() { data = NULL; }
+  KdNode() { data = NULL; index = -1; bias = 0.0f; }
 };
 typedef std::vector<KdNode> KdNodeVector;
 
@@ -85,7 +91,7 @@ class KdTree {
   CoordPoint lobound, upbound;
   // helper variable to check the distance method
   int distance_type;
-  bool neighbor_search(const CoordPoint& point, kdtree_node* node, size_t k, SearchQueue* neighborheap,DistanceMeasure * distance = nullptr);
+  bool neighbor_search(const CoordPoint& point, kdtree_node* node, size_t k, SearchQueue* neighborheap,DistanceMeasure * distance, const KdNodePredicate* pred);
   void range_search(const CoordPoint& point, kdtree_node* node, float r, std::vector<size_t>* range_result,DistanceMeasure* distance = nullptr);
   bool bounds_overlap_ball(const CoordPoint& point, float dist,
                            kdtree_node* node, DistanceMeasure * distance = nullptr);
@@ -93,8 +99,8 @@ class KdTree {
                           kdtree_node* node, DistanceMeasure * distance = nullptr);
   // class implementing the distance computation
   DistanceMeasure* default_distance;
-  // search predicate in knn searches
-  KdNodePredicate* searchpredicate;
+  // weights of default_distance
+  WeightVector weights;
 
  public:
   KdNodeVector allnodes;
@@ -105,7 +111,7 @@ class KdTree {
   ~KdTree();
   void set_distance(int distance_type, const WeightVector* weights = NULL);
   void k_nearest_neighbors(const CoordPoint& point, size_t k,
-                           KdNodeVector* result, KdNodePredicate* pred = NULL,const WeightVector * custom_weight = nullptr);
+                           KdNodeVector* result, KdNodePredicate* pred = NULL,const float* custom_weight = nullptr);
   void range_nearest_neighbors(const CoordPoint& point, float r,
                                KdNodeVector* result);
 };